@@ -0,0 +1,70 @@
+#include <cstdlib>
+#include <new>
+
+#include "AllocationCounter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+//trivial type : no dynamic initialisation, usable from operator new before main
+static thread_local unsigned long long threadAllocations = 0;
+
+unsigned long long
+AllocationCounter::getThreadCount(){
+    return threadAllocations;
+}
+
+bool
+AllocationCounter::isEnabled(){
+    return true;
+}
+
+//as the standard operator new : call the new handler until the allocation succeeds, bad_alloc without one
+void *operator new(std::size_t size){
+    threadAllocations++;
+    if(size == 0){
+        size = 1;
+    }
+    void *p;
+    while((p = std::malloc(size)) == nullptr){
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr){
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+    return p;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    try{
+        return ::operator new(size);
+    }catch(...){
+        return nullptr;
+    }
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+#else
+
+unsigned long long
+AllocationCounter::getThreadCount(){
+    return 0;
+}
+
+bool
+AllocationCounter::isEnabled(){
+    return false;
+}
+
+#endif // COUNT_ALLOCATIONS
@@ -0,0 +1,18 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+/**
+ * Count of the heap allocations (operator new) done by the calling thread.
+ * Diagnostic only : with COUNT_ALLOCATIONS defined (cmake -DCOUNT_ALLOCATIONS=ON)
+ * AllocationCounter.cpp replaces the global operator new to count, otherwise
+ * nothing is replaced and the count stays 0.
+ * Take the difference of two calls to measure a section of code.
+ **/
+class AllocationCounter{
+    public:
+        static unsigned long long getThreadCount();
+        //true if the allocations are counted
+        static bool isEnabled();
+};
+
+#endif // ALLOCATION_COUNTER_H
@@ -99,8 +99,8 @@ Centerline::optimizeElasticForces(std::vector<Z3i::RealPoint> aFiberRaw, double
                 ptMean /= aFace.size();
                 Z3i::RealPoint vecSM = ptMean - ptFiber;
 
-                double scala = vectorNormal.dot(vecSM)/vecSM.norm();
-                double angle = acos(std::abs(scala));
+                //angle between the face normal line and the radial vector
+                double angle = FastMath::atan2(vectorNormal.crossProduct(vecSM).norm(), std::abs(vectorNormal.dot(vecSM)));
                 //Do not count face with vector normal too different to vector radial (vecSM)
                 if(angle > M_PI/6){
                     continue;
@@ -251,7 +251,7 @@ Centerline::trackPatchCenter(const Z3i::Point &aStartingPoint, bool firstDirecti
         Z3i::RealPoint newDirVect = (currentPoint - previousPoint)/(currentPoint - previousPoint).norm();
         //trace.error()<<"angle"<<acos(newDirVect.dot(dirVect))<<std::endl;
         //should not go back
-        if(acos(newDirVect.dot(dirVect)) < M_PI/2){
+        if(newDirVect.dot(dirVect) > 0){
             //trace.error()<<"----------------" << std::endl;
             //trace.error()<<"currentPoint" << currentPoint<<std::endl;
             //trace.info()<<"previousPoint" << previousPoint<<std::endl;
@@ -13,6 +13,8 @@
 #include "DGtal/shapes/GaussDigitizer.h"
 #include "DGtal/kernel/PointVector.h"
 
+#include "../FastMath.h"
+
 //#include "DGtal/geometry/curves/AlphaThickSegmentComputer.h"
 
 class CenterlineHelper{
@@ -35,8 +37,7 @@ public:
         //check if first point is good
         TPoint v1 = fib.at(0) - fib.at(1);
         TPoint v2 = fib.at(2) - fib.at(1);
-        double cosA = v1.dot(v2)/v1.norm()/v2.norm();
-        double angle = acos(cosA);
+        double angle = FastMath::atan2(v1.crossProduct(v2).norm(), v1.dot(v2));
         unsigned start = 1;
 
         if(angle > minAngle){
@@ -49,8 +50,7 @@ public:
         for (unsigned int i = start; i < fib.size() - 2; i++){
             TPoint v1 = fibOut.at(fibOut.size() -1) - fib.at(i);
             TPoint v2 = fib.at(i+1) - fib.at(i);
-            double cosA = v1.dot(v2)/v1.norm()/v2.norm();
-            double angle = acos(cosA);
+            double angle = FastMath::atan2(v1.crossProduct(v2).norm(), v1.dot(v2));
             if(angle > minAngle){
             fibOut.push_back(fib.at(i));
             }
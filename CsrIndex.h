@@ -0,0 +1,95 @@
+#ifndef CSR_INDEX_H
+#define CSR_INDEX_H
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <numeric>
+
+#include "MultiThreadHelper.h"
+#include "Span.h"
+
+/**
+ * Compressed sparse row storage of the elements of a set of cells :
+ * the elements of cell c are indices[offsets[c]] ... indices[offsets[c+1] - 1],
+ * in increasing order. One allocation for the offsets, one for the indices.
+ **/
+class CsrIndex{
+    public:
+        CsrIndex(){}
+
+        /**
+        fill the cells from the cell of each element (cellOf[i] = cell of element i, cellOf[i] >= nbCells to skip it).
+        Counting pass then scatter pass, both run on the thread pool.
+        **/
+        void build(size_t nbCells, const std::vector<unsigned int> &cellOf){
+            ThreadPool &pool = ThreadPool::getInstance();
+            size_t nbElements = cellOf.size();
+            std::vector<std::atomic<unsigned int> > counts(nbCells);
+            pool.parallelFor(0, nbCells, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+                for(size_t c = lo; c < hi; c++){
+                    counts[c] = 0;
+                }
+            });
+            //counting pass
+            pool.parallelFor(0, nbElements, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+                for(size_t i = lo; i < hi; i++){
+                    if(cellOf[i] < nbCells){
+                        counts[cellOf[i]].fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            });
+            offsets.assign(nbCells + 1, 0);
+            for(size_t c = 0; c < nbCells; c++){
+                offsets[c + 1] = offsets[c] + counts[c];
+                //becomes the write cursor of the cell
+                counts[c] = offsets[c];
+            }
+            //scatter pass
+            indices.resize(offsets[nbCells]);
+            pool.parallelFor(0, nbElements, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+                for(size_t i = lo; i < hi; i++){
+                    if(cellOf[i] < nbCells){
+                        indices[counts[cellOf[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+                    }
+                }
+            });
+            //the scatter order depends on the scheduling, restore increasing order in each cell
+            pool.parallelFor(0, nbCells, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+                for(size_t c = lo; c < hi; c++){
+                    std::sort(indices.begin() + offsets[c], indices.begin() + offsets[c + 1]);
+                }
+            });
+        }
+
+        size_t getNbCells() const {
+            return offsets.empty() ? 0 : offsets.size() - 1;
+        }
+
+        const unsigned int *cellBegin(size_t c) const {
+            return indices.data() + offsets[c];
+        }
+
+        const unsigned int *cellEnd(size_t c) const {
+            return indices.data() + offsets[c + 1];
+        }
+
+        unsigned int cellSize(size_t c) const {
+            return offsets[c + 1] - offsets[c];
+        }
+
+        bool cellEmpty(size_t c) const {
+            return offsets[c + 1] == offsets[c];
+        }
+
+        Span<const unsigned int> cell(size_t c) const {
+            return Span<const unsigned int>(cellBegin(c), cellSize(c));
+        }
+
+        //first element of each cell (size nbCells + 1)
+        std::vector<unsigned int> offsets;
+        //elements of all cells, cell after cell
+        std::vector<unsigned int> indices;
+};
+
+#endif // CSR_INDEX_H
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <cmath>
+
+#include "CylindricalGrid.h"
+#include "MultiThreadHelper.h"
+
+void
+CylindricalGrid::build(const std::vector<CylindricalPoint> &points, double hStep, double aStep){
+    nbRows = 0;
+    if(points.empty()){
+        return;
+    }
+    auto minMaxHeight = std::minmax_element(points.begin(), points.end(),
+            [](const CylindricalPoint &p1, const CylindricalPoint &p2){ return p1.height < p2.height; });
+    minHeight = (*minMaxHeight.first).height;
+    double maxHeight = (*minMaxHeight.second).height;
+    heightStep = hStep > 0 ? hStep : 1.;
+    nbRows = (int) std::floor((maxHeight - minHeight) / heightStep) + 1;
+    nbCols = std::max(1, (int) std::floor(2*M_PI / aStep));
+    angleStep = 2*M_PI / nbCols;
+
+    //bucket of each point
+    std::vector<unsigned int> cellOf(points.size());
+    ThreadPool &pool = ThreadPool::getInstance();
+    pool.parallelFor(0, points.size(), PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t i = lo; i < hi; i++){
+            int r = std::min(nbRows - 1, (int) std::floor((points[i].height - minHeight) / heightStep));
+            int c = std::min(nbCols - 1, std::max(0, (int) std::floor(points[i].angle / angleStep)));
+            cellOf[i] = (unsigned int) r * nbCols + c;
+        }
+    });
+    buckets.build((size_t) nbRows * nbCols, cellOf);
+
+    //copy the coordinates in bucket order
+    heights.resize(buckets.indices.size());
+    angles.resize(buckets.indices.size());
+    pool.parallelFor(0, buckets.indices.size(), PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t k = lo; k < hi; k++){
+            heights[k] = points[buckets.indices[k]].height;
+            angles[k] = points[buckets.indices[k]].angle;
+        }
+    });
+}
+
+double
+CylindricalGrid::estimateInPatch(double height, double angle, double halfHeight, double halfAngle,
+                                 int rowBegin, int rowEnd, int colBegin, int colEnd) const {
+    //buckets entirely in the window
+    int rowInBegin = std::max(rowBegin, (int) std::ceil((height - halfHeight - minHeight) / heightStep));
+    int top = (int) std::floor((height + halfHeight - minHeight) / heightStep);
+    //the last row holds the highest point, it is entirely in when the window goes past its top
+    int rowInEnd = top >= nbRows ? rowEnd : std::min(rowEnd, top - 1);
+    int colInBegin = 0;
+    int colInEnd = nbCols - 1;
+    if(halfAngle < M_PI){
+        colInBegin = (int) std::ceil((angle - halfAngle) / angleStep);
+        colInEnd = (int) std::floor((angle + halfAngle) / angleStep) - 1;
+    }
+    size_t nbCovered = 0;
+    size_t nbInterior = 0;
+    for(int r = rowBegin; r <= rowEnd; r++){
+        for(int col = colBegin; col <= colEnd; col++){
+            size_t size = buckets.cellSize(cellOf(r, col));
+            nbCovered += size;
+            //column unwrapped in [colInBegin, colInBegin + nbCols[
+            int c = colInBegin + (((col - colInBegin) % nbCols) + nbCols) % nbCols;
+            if(r >= rowInBegin && r <= rowInEnd && c <= colInEnd){
+                nbInterior += size;
+            }
+        }
+    }
+    //areas in buckets, the window clipped to the rows of the grid
+    double interiorArea = (double) std::max(0, rowInEnd - rowInBegin + 1) * std::max(0, colInEnd - colInBegin + 1);
+    double boundaryArea = (double) (rowEnd - rowBegin + 1) * (colEnd - colBegin + 1) - interiorArea;
+    if(boundaryArea <= 0){
+        return nbInterior;
+    }
+    double windowRows = (std::min(height + halfHeight, minHeight + nbRows * heightStep) -
+                         std::max(height - halfHeight, minHeight)) / heightStep;
+    double windowCols = std::min(2 * halfAngle, 2 * M_PI) / angleStep;
+    double fraction = (std::max(0., windowRows) * windowCols - interiorArea) / boundaryArea;
+    fraction = std::min(1., std::max(0., fraction));
+    return nbInterior + fraction * (nbCovered - nbInterior);
+}
@@ -0,0 +1,106 @@
+#ifndef CYLINDRICAL_GRID_H
+#define CYLINDRICAL_GRID_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "CylindricalPoint.h"
+#include "CsrIndex.h"
+
+/**
+ * Bucket index of points over (height, angle), the angle wrapping around 2pi.
+ * Used to enumerate the points of a rectangular patch (height window x angular window)
+ * with a cost proportional to the patch size. Heights and angles are copied in bucket
+ * order so that a query reads contiguous memory.
+ **/
+class CylindricalGrid{
+    public:
+        CylindricalGrid(){}
+
+        /**
+        Build the buckets in O(N). heightStep is the bucket height. angleStep is rounded
+        up to divide 2pi (floor(2pi / angleStep) columns), so a bucket is at least angleStep wide.
+        **/
+        void build(const std::vector<CylindricalPoint> &points, double heightStep, double angleStep);
+
+        /**
+        call f(pointIndex, height, angle) on every point p with |p.height - height| <= halfHeight
+        and an angular distance to angle <= halfAngle.
+        **/
+        template<typename F>
+        void forEachInPatch(double height, double angle, double halfHeight, double halfAngle, const F &f) const {
+            forEachInPatch(height, angle, halfHeight, halfAngle, 0, f);
+        }
+
+        /**
+        same as above, but when the patch holds more than maxCandidates points (0 : no limit) only
+        one point every stride of the covering buckets is tested. The stride is the estimated number
+        of points in the window (estimateInPatch) divided by maxCandidates, rounded down, so about
+        maxCandidates points or a few more, evenly spread over the patch, are given to f.
+        The cost is bounded by the number of buckets plus the points tested.
+        **/
+        template<typename F>
+        void forEachInPatch(double height, double angle, double halfHeight, double halfAngle,
+                            size_t maxCandidates, const F &f) const {
+            if(nbRows == 0){
+                return;
+            }
+            int rowBegin = std::max(0, (int) std::floor((height - halfHeight - minHeight) / heightStep));
+            int rowEnd = std::min(nbRows - 1, (int) std::floor((height + halfHeight - minHeight) / heightStep));
+            int colBegin = (int) std::floor((angle - halfAngle) / angleStep);
+            int colEnd = (int) std::floor((angle + halfAngle) / angleStep);
+            if(colEnd - colBegin + 1 >= nbCols){
+                colBegin = 0;
+                colEnd = nbCols - 1;
+            }
+            size_t stride = 1;
+            if(maxCandidates > 0){
+                double estimate = estimateInPatch(height, angle, halfHeight, halfAngle, rowBegin, rowEnd, colBegin, colEnd);
+                stride = std::max((size_t) 1, (size_t) (estimate / maxCandidates));
+            }
+            //the stride runs over the concatenation of the buckets : skip is carried to the next one
+            size_t skip = 0;
+            for(int r = rowBegin; r <= rowEnd; r++){
+                for(int col = colBegin; col <= colEnd; col++){
+                    size_t cell = cellOf(r, col);
+                    size_t k = buckets.offsets[cell] + skip;
+                    for(; k < buckets.offsets[cell + 1]; k += stride){
+                        double angleDiff = std::abs(angles[k] - angle);
+                        if(std::abs(heights[k] - height) > halfHeight ||
+                           (angleDiff > halfAngle && 2*M_PI - angleDiff > halfAngle)){
+                            continue;
+                        }
+                        f(buckets.indices[k], heights[k], angles[k]);
+                    }
+                    skip = k - buckets.offsets[cell + 1];
+                }
+            }
+        }
+
+    protected:
+        //bucket of row r and column col, the column wrapping around 2pi
+        size_t cellOf(int r, int col) const {
+            return (size_t) r * nbCols + ((col % nbCols) + nbCols) % nbCols;
+        }
+
+        /**
+        estimated number of points of the window among the covering buckets [rowBegin, rowEnd] x [colBegin, colEnd] :
+        the points of the buckets entirely in the window, plus the points of the other covering buckets
+        weighted by the part of their area that lies in the window.
+        **/
+        double estimateInPatch(double height, double angle, double halfHeight, double halfAngle,
+                               int rowBegin, int rowEnd, int colBegin, int colEnd) const;
+
+        CsrIndex buckets;
+        //height and angle of the points in bucket order
+        std::vector<double> heights;
+        std::vector<double> angles;
+        double minHeight = 0.;
+        double heightStep = 1.;
+        double angleStep = 2*M_PI;
+        int nbRows = 0;
+        int nbCols = 1;
+};
+
+#endif // CYLINDRICAL_GRID_H
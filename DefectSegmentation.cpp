@@ -22,6 +22,10 @@
 #include "Statistic.h"
 #include "IOHelper.h"
 #include "MultiThreadHelper.h"
+#include "PatchFitter.h"
+
+//patch regression of the Van Tho method
+typedef PatchFitter<KdTreeBallQuery, LinearRegressionKernel> VanThoPatchFitter;
 
 using namespace DGtal;
 
@@ -34,8 +38,13 @@ DefectSegmentation::init(){
     computeBeginOfSegment();
     computeVectorMarks();
     computePlaneNormals();
+    computeSegmentFrames();
 
 	convertToCcs();
+    if(spatialReorder){
+        reorderPoints();
+    }
+    computeSegmentPatchAngles();
 
     computeEquations();
     computeDistances();
@@ -68,72 +77,29 @@ DefectSegmentation::computeEquations(){
     double minHeight = (*minMaxElem.first).height;
     double maxHeight = (*minMaxElem.second).height;
 
-    int nbCores = getNumCores();
-    std::vector<std::thread> ts;
-    for(int i = 0; i < nbCores - 1; i++){
-        ts.push_back(std::thread(&DefectSegmentation::computeEquationsMultiThread, this, i, nbCores, kdtree, minHeight, maxHeight));
-    }
-    computeEquationsMultiThread(nbCores - 1, nbCores, kdtree, minHeight, maxHeight);
-    for(int i = 0; i < nbCores - 1; i++){
-        ts[i].join();
-    }
+    //the kdtree is built once and shared read only by all the workers of the pool
+    VanThoPatchFitter fitter(KdTreeBallQuery(kdtree, pointCloud, myPoints, patchHeight, segmentPatchAngles, minHeight, maxHeight),
+                             LinearRegressionKernel(), originalIds);
+    fitter.setMaxPoints(maxPatchPoints);
+    ThreadPool &pool = ThreadPool::getInstance();
+    pool.resetBusyTimes();
+    fitter.run(0, pointCloud.size(), PATCH_GRAIN, coefficients);
+    reportBusyTimes(pool.getBusyTimes());
     trace.info()<<"finish eq"<<std::endl;
 }
-void
-DefectSegmentation::computeEquationsMultiThread(int threadId, int nbThread,
-        const pcl::KdTreeFLANN<pcl::PointXYZ> &kdtree,
-        double minHeight, double maxHeight){
-
-    double patchAngle = arcLength / radii;
-    for(unsigned int i = threadId; i < pointCloud.size();i+=nbThread){
-        Z3i::RealPoint currentPoint = pointCloud.at(i);
-        CylindricalPoint mpCurrent = myPoints.at(i);
-        pcl::PointXYZ searchPoint(currentPoint[0], currentPoint[1], currentPoint[2]);
-        std::vector<int> pointIdx;
-        std::vector<float> pointRadiusSquaredDistance;
-
-        std::vector<double> radiusForEstimate;
-        std::vector<double> lengthForEstimate;
-
-        double searchRadius = patchHeight / 2 + 1;
-        if(mpCurrent.height - minHeight < patchHeight /2){
-            searchRadius += mpCurrent.height - minHeight;
-        }else if(maxHeight - mpCurrent.height < patchHeight/2){
-            searchRadius += maxHeight - mpCurrent.height;
-        }
-        if ( kdtree.radiusSearch (searchPoint, searchRadius, pointIdx, pointRadiusSquaredDistance) > 0 ){
-            for (unsigned int idx = 0; idx < pointIdx.size (); ++idx){
-                //index of dgtal and pcl is the same
-                unsigned int foundedIndex = pointIdx.at(idx);
-                Z3i::RealPoint found = pointCloud.at(foundedIndex);
-                CylindricalPoint mpFound = myPoints.at(foundedIndex);
-                double angleDiff = std::abs(mpFound.angle - mpCurrent.angle);
-                if(angleDiff > patchAngle/2 && 2*M_PI - angleDiff > patchAngle / 2){
-                    continue;
-                }
-                radiusForEstimate.push_back(mpFound.radius);
-                lengthForEstimate.push_back(mpFound.height);
-            }
-        }
-        //coefficients[i] = Regression::robustLinearOls(lengthForEstimate, radiusForEstimate);
-        //coefficients2[i] = coefficients[i];// = Regression::robustLinearOls(lengthForEstimate, radiusForEstimate);
-        coefficients[i] = Regression::linearRegression(lengthForEstimate, radiusForEstimate);
-        //coefficients[i] = coefficients2[i];
-    }
-}
-
 
 void DefectSegmentation::computeDistances(){
-
-    for(unsigned int i = 0; i < myPoints.size(); i++){
-        std::pair<double, double> coeffs = coefficients[i];
-        if(coeffs.second == 0.0){
-            distances[i] = 0;
-        }else{
-            double estimateRadii = myPoints[i].height * coeffs.first + coeffs.second;
-            distances[i] = myPoints[i].radius - estimateRadii;
+    ThreadPool::getInstance().parallelFor(0, myPoints.size(), PARALLEL_GRAIN, [this](size_t, size_t chunkBegin, size_t chunkEnd){
+        for(size_t i = chunkBegin; i < chunkEnd; i++){
+            const std::pair<double, double> &coeffs = coefficients[i];
+            if(coeffs.second == 0.0){
+                distances[i] = 0;
+            }else{
+                double estimateRadii = myPoints[i].height * coeffs.first + coeffs.second;
+                distances[i] = myPoints[i].radius - estimateRadii;
+            }
         }
-    }
+    });
 }
 
 std::pair<double, double> DefectSegmentation::getCoeffs(unsigned int pointId){
@@ -48,12 +48,6 @@ class DefectSegmentation : public SegmentationAbstract {
          */
         void computeEquations() override;
 
-        /** Brief 
-         * Call by computeEquations
-         */
-        void computeEquationsMultiThread(int threadId, int nbThread, const pcl::KdTreeFLANN<pcl::PointXYZ> &kdtree, 
-                             double minHeight, double maxHeight);
-
         void computeDistances() override;
 
         //coefficients of regressed lines, one line for each windows
@@ -4,6 +4,7 @@
 #include <utility>
 #include <cmath>
 #include <thread>
+#include <chrono>
 //debug
 #include <stdlib.h>
 #include <time.h>
@@ -40,6 +41,12 @@
 #include "IOHelper.h"
 #include "MultiThreadHelper.h"
 #include "UnrolledMap.h"
+#include "CylindricalGrid.h"
+#include "SlidingPatchRegression.h"
+#include "PatchFitter.h"
+
+//patch regression of the unroll method
+typedef PatchFitter<GridPatchQuery, PurgedRegressionKernel> UnrollPatchFitter;
 
 
 using namespace DGtal;
@@ -52,7 +59,12 @@ DefectSegmentationUnroll::init(){
     computeBeginOfSegment();
     computeVectorMarks();
     computePlaneNormals();
+    computeSegmentFrames();
     convertToCcs();
+    if(spatialReorder){
+        reorderPoints();
+    }
+    computeSegmentPatchAngles();
 
     allocateExtra();
 
@@ -64,123 +76,275 @@ DefectSegmentationUnroll::init(){
 void
 DefectSegmentationUnroll::allocateExtra(){
   coefficients.resize(pointCloud.size());
-  ind_Patches.resize(pointCloud.size());
 }
 
 
 
 void
-DefectSegmentationUnroll::computeEquations(){
-  trace.info()<<"Begin Compute Equation"<<std::endl;
-  pcl::PointCloud<pcl::PointXYZ>::Ptr cloudPcl(new pcl::PointCloud<pcl::PointXYZ>);
-  for(int i = 0; i < pointCloud.size(); i++){
-      Z3i::RealPoint p = pointCloud.at(i);
-      cloudPcl->points.push_back(pcl::PointXYZ(p[0], p[1], p[2]));
-  }
-
-  pcl::KdTreeFLANN<pcl::PointXYZ> kdtree;
-  kdtree.setInputCloud (cloudPcl);
+DefectSegmentationUnroll::setPatchEngine(PatchEngine engine, bool compare){
+  patchEngine = engine;
+  compareEngines = compare;
+}
 
-  CylindricalPointOrder heightOrder;
-  auto minMaxElem = std::minmax_element(myPoints.begin(), myPoints.end(), heightOrder);
-  double minH= (*minMaxElem.first).height;
-  double maxH = (*minMaxElem.second).height;
 
-  int nbCores = getNumCores();
-  std::vector<std::thread> ts;
-  for(int i = 0; i < nbCores - 1; i++){
-      ts.push_back(std::thread(&DefectSegmentationUnroll::computeEquationsMultiThread, this, i, nbCores, kdtree, minH, maxH));
-  }
-  computeEquationsMultiThread(nbCores - 1, nbCores, kdtree, minH, maxH);
-  for(int i = 0; i < nbCores - 1; i++){
-      ts[i].join();
-  }
-  trace.info()<<"finish eq"<<std::endl;
+void
+DefectSegmentationUnroll::setRecordPatches(bool record){
+  recordPatches = record;
 }
 
-std::pair<double, double>
-DefectSegmentationUnroll::computeEq(unsigned int idPoint,double searchRadius, double patchAngle,const pcl::KdTreeFLANN<pcl::PointXYZ> &kdtree){
-  Z3i::RealPoint currentPoint = pointCloud.at(idPoint);
-  CylindricalPoint mpCurrent = myPoints.at(idPoint);
-  pcl::PointXYZ searchPoint(currentPoint[0], currentPoint[1], currentPoint[2]);
 
-  std::vector<int> pointIdx;
-  std::vector<double> radiusForEstimate;
-  std::vector<double> angleForEstimate;
-  std::vector<double> lengthForEstimate;
-  std::vector<unsigned int> indForEstimate;
-  std::vector<float> pointRadiusSquaredDistance;
+const PatchMembership &
+DefectSegmentationUnroll::getPatchMembership() const {
+  return patchMembership;
+}
 
 
-  if ( kdtree.radiusSearch (searchPoint, searchRadius, pointIdx, pointRadiusSquaredDistance) > 0 ){
-    for (unsigned int idx = 0; idx < pointIdx.size (); ++idx){
-      unsigned int foundedIndex = pointIdx.at(idx);
+void
+DefectSegmentationUnroll::setPatchKernel(PatchKernel kernel){
+  patchKernel = kernel;
+}
 
-      CylindricalPoint mpFound = myPoints.at(foundedIndex);
-      double angleDiff = std::abs(mpFound.angle - mpCurrent.angle);
-      if(angleDiff > patchAngle/2 && 2*M_PI - angleDiff > patchAngle / 2){
-        continue;
-      }
-      //fill the patches vector
-      angleForEstimate.push_back(mpFound.angle);
-      radiusForEstimate.push_back(mpFound.radius);
-      lengthForEstimate.push_back(mpFound.height);
-      indForEstimate.push_back(foundedIndex);
-    }
-  }
-  struct coefs c= Regression::PurgedlinearRegression(lengthForEstimate, radiusForEstimate, angleForEstimate,indForEstimate);
-  std::pair<double, double> coef;
 
-  coef=c.coefficients;
-  ind_Patches.at(idPoint)=c.ind_p;
-  return coef;
+void
+DefectSegmentationUnroll::setLatticeStep(double step){
+  latticeStep = step;
 }
 
+void
+DefectSegmentationUnroll::setReliefReduction(ReliefReduction reduction){
+  reliefReduction = reduction;
+}
 
 void
-DefectSegmentationUnroll::computeEquationsMultiThread(int threadId, int nbThread,const pcl::KdTreeFLANN<pcl::PointXYZ> &kdtree, double minH, double maxH){
-  std::pair<double, double> currentCoefficient;
+DefectSegmentationUnroll::setReliefTensor(bool write){
+  reliefTensor = write;
+}
 
-  double patchAngle = arcLength / radii;
+void
+DefectSegmentationUnroll::setPixelPitch(double aHeightPitch, double anArcPitch){
+  heightPitch = aHeightPitch;
+  arcPitch = anArcPitch;
+}
 
-  double searchRadius = patchHeight / 2 + 1;
 
-  for(unsigned int i = threadId; i < pointCloud.size();i+=nbThread){
-    CylindricalPoint mpCurrent = myPoints.at(i);
-    currentCoefficient = computeEq(i,searchRadius,patchAngle,kdtree);
-    coefficients[i]=currentCoefficient;
+void
+DefectSegmentationUnroll::computeEquations(){
+  trace.info()<<"Begin Compute Equation"<<std::endl;
+  auto start = std::chrono::steady_clock::now();
+  if(recordPatches && patchEngine != EXACT_PATCH){
+    trace.warning()<<"patches are only recorded by the exact patch engine, nothing recorded"<<std::endl;
+  }
+  if(patchEngine == PREFIX_SUM_PATCH){
+    computeEquationsPrefixSum();
+  }else if(patchEngine == LATTICE_PATCH){
+    computeEquationsLattice();
+  }else{
+    computeEquationsExact();
+  }
+  double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  const char *engineNames[] = {"exact", "prefix sum", "lattice"};
+  trace.info()<<"patch engine "<<engineNames[patchEngine]<<" : "<<duration<<" ms"<<std::endl;
+
+  if(compareEngines && patchEngine != EXACT_PATCH){
+    std::vector<std::pair<double, double> > engineCoefficients = coefficients;
+    //the reference run must not record its patches as the ones of the selected engine
+    bool record = recordPatches;
+    recordPatches = false;
+    start = std::chrono::steady_clock::now();
+    computeEquationsExact();
+    recordPatches = record;
+    double exactDuration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    trace.info()<<"patch engine exact : "<<exactDuration<<" ms (speedup "<<exactDuration / duration<<")"<<std::endl;
+    std::vector<std::pair<double, double> > exactCoefficients = coefficients;
+    coefficients = engineCoefficients;
+    reportDeviation(exactCoefficients);
   }
+  trace.info()<<"finish eq"<<std::endl;
 }
 
 void
-DefectSegmentationUnroll::computeDistances(){
-  //NOT USED, artefact from Van Tho code
+DefectSegmentationUnroll::computeEquationsExact(){
+  if(patchKernel == ROBUST_KERNEL){
+    computeEquationsExact(RobustRegressionKernel());
+  }else{
+    computeEquationsExact(PurgedRegressionKernel());
+  }
 }
 
-
-using namespace functors;
+template<typename Kernel>
 void
-DefectSegmentationUnroll::computeDeltaDistances(){
+DefectSegmentationUnroll::computeEquationsExact(const Kernel &kernel){
+  double patchAngle = arcLength / radii;
+  //buckets of a quarter of patch height and half a patch width : a patch covers a few buckets
+  CylindricalGrid grid;
+  grid.build(myPoints, std::max(1.0, patchHeight / 4.0), patchAngle / 2);
+
+  ThreadPool &pool = ThreadPool::getInstance();
+  pool.resetBusyTimes();
+  if(recordPatches){
+    patchMembership.beginBuild(pointCloud.size(), ThreadPool::getNbChunks(0, pointCloud.size(), PATCH_GRAIN));
+  }
+  PatchFitter<GridPatchQuery, Kernel> fitter(GridPatchQuery(grid, myPoints, patchHeight, patchAngle, segmentPatchAngles), kernel, originalIds);
+  fitter.setMaxPoints(maxPatchPoints);
+  unsigned long long nbAllocations = fitter.run(0, pointCloud.size(), PATCH_GRAIN, coefficients,
+                                                [&](size_t chunkId, size_t idPoint, PatchScratch &scratch){
+    if(recordPatches){
+      std::vector<unsigned int> &fitPoints = Kernel::getFitPoints(scratch);
+      patchMembership.append(chunkId, idPoint, fitPoints.data(), fitPoints.size());
+    }
+  });
+  reportBusyTimes(pool.getBusyTimes());
+  //only the growth of the scratch buffers (and of the recorded patches) should remain
+  if(AllocationCounter::isEnabled()){
+    trace.info()<<"heap allocations in the patch loop : "<<nbAllocations<<std::endl;
+  }else{
+    trace.info()<<"heap allocations in the patch loop : n/a (build with COUNT_ALLOCATIONS)"<<std::endl;
+  }
+  if(recordPatches){
+    patchMembership.finishBuild();
+    trace.info()<<"recorded patches : "<<patchMembership.getNbBytes()<<" bytes for "<<patchMembership.getNbIndices()
+                <<" indices ("<<patchMembership.getNbIndices() * sizeof(unsigned int)<<" bytes uncompressed)"<<std::endl;
+  }
+}
 
-  for(unsigned int i = 0; i < myPoints.size(); i++){
-      std::pair<double, double> coeffs = coefficients[i];
-      double estimateRadii = myPoints[i].height * coeffs.first + coeffs.second;
-      if(coeffs.second == 0.0){
-          distances[i] = 0;
-      }else{
-          distances[i] = myPoints[i].radius - estimateRadii;
+void
+DefectSegmentationUnroll::computeEquationsPrefixSum(){
+  double patchAngle = arcLength / radii;
+  SlidingPatchRegression regression(myPoints, patchHeight, patchAngle);
+  regression.compute(coefficients);
+  //patches which need RANSAC go through the exact path
+  std::vector<unsigned int> fallbackPoints = regression.getFallbackPoints();
+  if(!fallbackPoints.empty()){
+    trace.info()<<fallbackPoints.size()<<" points computed with the exact engine"<<std::endl;
+    CylindricalGrid grid;
+    grid.build(myPoints, std::max(1.0, patchHeight / 4.0), patchAngle / 2);
+    UnrollPatchFitter fitter(GridPatchQuery(grid, myPoints, patchHeight, patchAngle, segmentPatchAngles), PurgedRegressionKernel(), originalIds);
+    fitter.setMaxPoints(maxPatchPoints);
+    ThreadPool::getInstance().parallelFor(0, fallbackPoints.size(), PATCH_GRAIN, [&](size_t, size_t lo, size_t hi){
+      for(size_t k = lo; k < hi; k++){
+        coefficients[fallbackPoints[k]] = fitter.fit(fallbackPoints[k]);
       }
+    });
+  }
+}
 
+void
+DefectSegmentationUnroll::computeEquationsLattice(){
+  if(patchKernel == ROBUST_KERNEL){
+    computeEquationsLattice(RobustRegressionKernel());
+  }else{
+    computeEquationsLattice(PurgedRegressionKernel());
   }
 }
 
+template<typename Kernel>
 void
-DefectSegmentationUnroll::computeRadiusDistances(){
+DefectSegmentationUnroll::computeEquationsLattice(const Kernel &kernel){
+  if(myPoints.empty()){
+    return;
+  }
+  double patchAngle = arcLength / radii;
+  CylindricalGrid grid;
+  grid.build(myPoints, std::max(1.0, patchHeight / 4.0), patchAngle / 2);
+
+  //nodes every latticeStep along the height and along the arc of the mean radius, the angle step divides 2pi
+  auto minMaxHeight = std::minmax_element(myPoints.begin(), myPoints.end(),
+      [](const CylindricalPoint &p1, const CylindricalPoint &p2){ return p1.height < p2.height; });
+  double minHeight = (*minMaxHeight.first).height;
+  double maxHeight = (*minMaxHeight.second).height;
+  int nbRows = (int) std::ceil((maxHeight - minHeight) / latticeStep) + 1;
+  int nbCols = std::max(1, (int) std::round(2*M_PI * radii / latticeStep));
+  double angleStep = 2*M_PI / nbCols;
+
+  std::vector<std::pair<double, double> > nodeCoefficients((size_t) nbRows * nbCols);
+  PatchFitter<GridPatchQuery, Kernel> fitter(GridPatchQuery(grid, myPoints, patchHeight, patchAngle, segmentPatchAngles), kernel, originalIds);
+  fitter.setMaxPoints(maxPatchPoints);
+  ThreadPool &pool = ThreadPool::getInstance();
+  pool.parallelFor(0, nodeCoefficients.size(), PATCH_GRAIN, [&](size_t, size_t lo, size_t hi){
+    for(size_t k = lo; k < hi; k++){
+      nodeCoefficients[k] = fitter.fitAt(minHeight + (k / nbCols) * latticeStep, (k % nbCols) * angleStep, k);
+    }
+  });
+  trace.info()<<nodeCoefficients.size()<<" lattice fits for "<<myPoints.size()<<" points"<<std::endl;
+
+  //bilinear interpolation of the lines of the 4 nodes around each point,
+  //nodes without line (too few points) are left out and the weights renormalized
+  pool.parallelFor(0, myPoints.size(), PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+    for(size_t i = lo; i < hi; i++){
+      double fr = (myPoints[i].height - minHeight) / latticeStep;
+      int r0 = std::min(std::max(0, (int) std::floor(fr)), nbRows - 1);
+      int r1 = std::min(r0 + 1, nbRows - 1);
+      double t = std::min(1., std::max(0., fr - r0));
+      double fc = myPoints[i].angle / angleStep;
+      int c0 = (((int) std::floor(fc)) % nbCols + nbCols) % nbCols;
+      int c1 = (c0 + 1) % nbCols;
+      double u = std::min(1., std::max(0., fc - std::floor(fc)));
+      const int rows[4] = {r0, r0, r1, r1};
+      const int cols[4] = {c0, c1, c0, c1};
+      const double weights[4] = {(1 - t) * (1 - u), (1 - t) * u, t * (1 - u), t * u};
+      double a = 0., b = 0., sumWeights = 0.;
+      for(int n = 0; n < 4; n++){
+        const std::pair<double, double> &line = nodeCoefficients[(size_t) rows[n] * nbCols + cols[n]];
+        if(line.second == 0.0){
+          continue;
+        }
+        a += weights[n] * line.first;
+        b += weights[n] * line.second;
+        sumWeights += weights[n];
+      }
+      if(sumWeights > 0){
+        coefficients[i] = std::pair<double, double>(a / sumWeights, b / sumWeights);
+      }else{
+        coefficients[i] = std::pair<double, double>(0., 0.);
+      }
+    }
+  });
+}
 
+void
+DefectSegmentationUnroll::reportDeviation(const std::vector<std::pair<double, double> > &exactCoefficients){
+  double maxDeviation = 0.;
+  double sumDeviation = 0.;
   for(unsigned int i = 0; i < myPoints.size(); i++){
-    distances[i] = myPoints[i].radius;
+    double h = myPoints[i].height;
+    double deviation = std::abs((coefficients[i].first - exactCoefficients[i].first) * h
+                                + coefficients[i].second - exactCoefficients[i].second);
+    maxDeviation = std::max(maxDeviation, deviation);
+    sumDeviation += deviation;
   }
+  trace.info()<<"reference radius deviation from exact engine : max "<<maxDeviation
+              <<" mean "<<sumDeviation / myPoints.size()<<std::endl;
+}
 
+void
+DefectSegmentationUnroll::computeDistances(){
+  //NOT USED, artefact from Van Tho code
+}
+
+
+using namespace functors;
+void
+DefectSegmentationUnroll::computeDeltaDistances(){
+  ThreadPool::getInstance().parallelFor(0, myPoints.size(), PARALLEL_GRAIN, [this](size_t, size_t chunkBegin, size_t chunkEnd){
+    for(size_t i = chunkBegin; i < chunkEnd; i++){
+        const std::pair<double, double> &coeffs = coefficients[i];
+        double estimateRadii = myPoints[i].height * coeffs.first + coeffs.second;
+        if(coeffs.second == 0.0){
+            distances[i] = 0;
+        }else{
+            distances[i] = myPoints[i].radius - estimateRadii;
+        }
+    }
+  });
+}
+
+void
+DefectSegmentationUnroll::computeRadiusDistances(){
+  ThreadPool::getInstance().parallelFor(0, myPoints.size(), PARALLEL_GRAIN, [this](size_t, size_t chunkBegin, size_t chunkEnd){
+    for(size_t i = chunkBegin; i < chunkEnd; i++){
+      distances[i] = myPoints[i].radius;
+    }
+  });
 }
 
 
@@ -198,6 +362,8 @@ DefectSegmentationUnroll::makeRM(std::string outputFileName,std::string gtName,i
   //computeDeltaDistancesRosin();
   //Construct Unrolled_map with a vectorof distance (vector size = point cloud size)
   UnrolledMap unrolled_map(myPoints,distances,dF,gs_ori,intensity);
+  unrolled_map.setReliefReduction(reliefReduction);
+  unrolled_map.setPixelPitch(heightPitch,arcPitch);
                     /*******************************/
                     /*Discretisation by unrolledMap*/
                     /*******************************/
@@ -217,6 +383,13 @@ DefectSegmentationUnroll::makeRM(std::string outputFileName,std::string gtName,i
   unrolled_map.computeGRAYImage();
   //get and write gray image
   unrolled_map.getReliefImageGrayScale()>>outputFileName+".pgm";
+  //relief, density, radius and fill level channels for the CNN
+  if(reliefTensor){
+    std::vector<float> tensor;
+    int nbRows, nbCols;
+    unrolled_map.computeReliefTensor(tensor,nbRows,nbCols);
+    IOHelper::writeTensorToFile(tensor,RELIEF_TENSOR_CHANNELS,nbRows,nbCols,unrolled_map.getRowCroppedBot(),outputFileName+".tensor");
+  }
   //compute rgb image from unrolledmap
   //unrolled_map.computeRGBImage();
   //get and write rgb image
@@ -225,7 +398,9 @@ DefectSegmentationUnroll::makeRM(std::string outputFileName,std::string gtName,i
                     /*****************************************/
                     /*write discretisation vector in txt file*/
                     /*****************************************/
-  IOHelper::writeDiscretisationToFile(unrolled_map.getDiscretisation(),unrolled_map.getRowCroppedBot(),unrolled_map.getRowCroppedTop(),"discretisation.txt");
+  //cells are written with the index of the points in the original mesh
+  IOHelper::writeDiscretisationToFile(unrolled_map.getDiscretisation(),unrolled_map.getHeightDiv(),unrolled_map.getAngleDiv(),
+                                      unrolled_map.getHeightPitch(),unrolled_map.getArcPitch(),originalIds,unrolled_map.getRowCroppedBot(),unrolled_map.getRowCroppedTop(),"discretisation.txt");
                     /**********************************************************/
                     /*make grounthTruth relief map (for deeplearning training)
                     /*CAREFULL : NEED OPENCV                                  */
@@ -18,10 +18,31 @@
 
 #include "SegmentationAbstract.h"
 #include "CylindricalPoint.h"
+#include "CylindricalGrid.h"
+#include "PatchMembership.h"
+#include "ReliefReducer.h"
 
 
 using namespace DGtal;
 
+//how the line of the patch of each point is computed
+enum PatchEngine {
+  //PurgedlinearRegression on the points of each patch
+  EXACT_PATCH,
+  //prefix sums of the moments over (height, angle) bins, O(1) per point (see SlidingPatchRegression)
+  PREFIX_SUM_PATCH,
+  //exact fits only at the nodes of a coarse (height, angle) lattice, bilinear interpolation of the lines
+  LATTICE_PATCH
+};
+
+//regression of the points of a patch (exact and lattice engines)
+enum PatchKernel {
+  //PurgedlinearRegression : least squares without the outliers, RANSAC on noisy patches, median shift
+  PURGED_KERNEL,
+  //Regression::robustLinear : IRLS with the fair weight function
+  ROBUST_KERNEL
+};
+
 class DefectSegmentationUnroll : public SegmentationAbstract {
   public:
 
@@ -29,15 +50,49 @@ class DefectSegmentationUnroll : public SegmentationAbstract {
 
     void init() override;
 
-    void makeRM(std::string output,std::string gtName,int dF,int gs_ori,int intensity);
+    /**
+    Select the patch engine. If compare is true the exact engine is also run and the
+    timings and the deviation of the reference radius are reported.
+    **/
+    void setPatchEngine(PatchEngine engine, bool compare);
 
-  protected:
+    /**
+    Select the regression of the patches of the exact and lattice engines (PURGED_KERNEL by default)
+    **/
+    void setPatchKernel(PatchKernel kernel);
 
+    /**
+    Spacing (mm, along the height and along the arc) of the nodes of LATTICE_PATCH
+    **/
+    void setLatticeStep(double step);
 
     /**
-    Compute line coeficient for one id point
+    Record the points of the patch of each point, for inspection with ImageAnalyser. Only the exact
+    engine records, the other engines log a warning and leave the membership empty.
     **/
-    std::pair<double, double> computeEq(unsigned int idPoint,double searchRadius, double patchAngle,const pcl::KdTreeFLANN<pcl::PointXYZ> &kdtree);
+    void setRecordPatches(bool record);
+    const PatchMembership &getPatchMembership() const;
+
+    /**
+    Reduction of the relief of the points of a cell in the relief map (MAX_RELIEF by default)
+    **/
+    void setReliefReduction(ReliefReduction reduction);
+
+    /**
+    Also write the relief tensor of UnrolledMap::computeReliefTensor in <output>.tensor
+    **/
+    void setReliefTensor(bool write);
+
+    /**
+    Size (mm) of a pixel of the relief map along the height and along the arc (1 x 1 by default)
+    **/
+    void setPixelPitch(double heightPitch, double arcPitch);
+
+    void makeRM(std::string output,std::string gtName,int dF,int gs_ori,int intensity);
+
+  protected:
+
+
     /**
      * Allocate space for unrollMap
      **/
@@ -46,10 +101,26 @@ class DefectSegmentationUnroll : public SegmentationAbstract {
     Refactor with Van tho'code
      **/
     void computeEquations() override;
-    /** Brief
-    Refactor with Van tho'code
+    /**
+    Compute line coefficients of all points with the exact engine and the kernel of patchKernel
+    **/
+    void computeEquationsExact();
+    template<typename Kernel>
+    void computeEquationsExact(const Kernel &kernel);
+    /**
+    Compute line coefficients of all points with the prefix sums engine
+    **/
+    void computeEquationsPrefixSum();
+    /**
+    Compute line coefficients at the lattice nodes and interpolate them at each point
+    **/
+    void computeEquationsLattice();
+    template<typename Kernel>
+    void computeEquationsLattice(const Kernel &kernel);
+    /**
+    Report the deviation of the reference radius computed with coefficients from the one of exactCoefficients
     **/
-    void computeEquationsMultiThread(int threadId, int nbThread, const pcl::KdTreeFLANN<pcl::PointXYZ> &kdtree, double minHeight, double maxHeight);
+    void reportDeviation(const std::vector<std::pair<double, double> > &exactCoefficients);
     /**
     Compute Delta distance for each pôints
      **/
@@ -65,8 +136,24 @@ class DefectSegmentationUnroll : public SegmentationAbstract {
     void computeDistances() override;
     //coefficients of regressed lines, one line for each windows a window = some bands consecutives
     std::vector<std::pair<double, double> > coefficients;
-    //For each point store the patch for ImageAnalyser
-    std::vector<std::vector<unsigned int>> ind_Patches;
+    //if recordPatches, for each point the points of its patch for ImageAnalyser
+    bool recordPatches = false;
+    PatchMembership patchMembership;
+    //engine used by computeEquations
+    PatchEngine patchEngine = EXACT_PATCH;
+    //regression of the patches
+    PatchKernel patchKernel = PURGED_KERNEL;
+    //run also the exact engine and report the differences
+    bool compareEngines = false;
+    //spacing of the lattice nodes (mm)
+    double latticeStep = 5.0;
+    //reduction of the cells of the relief map
+    ReliefReduction reliefReduction = MAX_RELIEF;
+    //write the relief tensor
+    bool reliefTensor = false;
+    //size of a pixel of the relief map (mm)
+    double heightPitch = 1.;
+    double arcPitch = 1.;
 
 
 };
@@ -1,5 +1,9 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
 
 #include <stdlib.h>
 
@@ -55,24 +59,22 @@ void IOHelper::readDistanceFromFile(const std::string &fileName, std::vector<dou
     }
   }
 
-void IOHelper::writeDiscretisationToFile(const std::vector<std::vector<std::vector<unsigned int>>> &discretisation,const int &rowcroppedBot,const int &rowcroppedTop, const std::string &fileName){
+void IOHelper::writeDiscretisationToFile(const CsrIndex &discretisation,const int &rows,const int &cols,const double &heightPitch,const double &arcPitch,
+                                         const std::vector<unsigned int> &ids,const int &rowcroppedBot,const int &rowcroppedTop, const std::string &fileName){
   trace.info()<<"Writting discretisation ..."<<std::endl;
   std::ofstream outStream;
   outStream.open(fileName.c_str(), std::ofstream::out);
-  //first line is for dimension X/Y of discretisation
-  outStream<<discretisation.size()<<" "<<discretisation[0].size()<<std::endl;
+  //first line is for dimension X/Y of discretisation, then the size of the cells (older readers stop at the dimension)
+  outStream<<rows<<" "<<cols<<" "<<heightPitch<<" "<<arcPitch<<std::endl;
   //Second line is for nb line cropped
   outStream<<rowcroppedBot<<" "<<rowcroppedTop<<std::endl;
-  //then the discretisation
-  int rows=discretisation.size();
-  int cols=discretisation[0].size();
-
+  //then the discretisation, column after column
   for (int i=0; i < cols; ++i){
     for (int j=0; j < rows; ++j){
-      std::vector<unsigned int> v =discretisation.at(j).at(i) ;
+      Span<const unsigned int> v = discretisation.cell((size_t) j*cols+i);
       if(!v.empty()){
-        for(auto it = v.begin(); it != v.end(); ++it) {
-          outStream << *it;
+        for(unsigned int ind : v) {
+          outStream << (ids.empty() ? ind : ids[ind]);
           outStream << " ";
         }
         outStream<<std::endl;
@@ -83,7 +85,8 @@ void IOHelper::writeDiscretisationToFile(const std::vector<std::vector<std::vect
   }
   outStream.close();
 }
-void IOHelper::readDiscretisationFromFile(const std::string &fileName, std::vector<std::vector<std::vector<unsigned int>>> &discretisation, int &rowcroppedBot,int &rowcroppedTop){
+void IOHelper::readDiscretisationFromFile(const std::string &fileName, CsrIndex &discretisation, int &rows, int &cols, double &heightPitch, double &arcPitch,
+                                          int &rowcroppedBot,int &rowcroppedTop){
   std::ifstream infile;
   infile.open(fileName.c_str(), std::ifstream::in);
   std::string currentLine;
@@ -92,22 +95,17 @@ void IOHelper::readDiscretisationFromFile(const std::string &fileName, std::vect
 
   getline(infile, currentLine);
   //Here we want to read the dimension of the image. In discretisation.txt, dimension are delimited by a single space : dimY dimX. Dimension is located at the first line of the file
-  int cols,rows;
-
-  subLine=currentLine.substr(0, currentLine.find(delimiter));
-  if(subLine.empty()){
-    trace.info()<<"Problem in discretisation.txt. First line shoulde be : dimX dimY"<<std::endl;
-  }else{
-    rows=std::stoi(subLine);
+  rows=0;
+  cols=0;
+  std::stringstream dimensionStream(currentLine);
+  if(!(dimensionStream>>rows>>cols)){
+    trace.info()<<"Problem in discretisation.txt. First line shoulde be : dimX dimY [heightPitch arcPitch]"<<std::endl;
   }
-  subLine=currentLine.substr(currentLine.find(delimiter)+1,currentLine.size() );
-  if(subLine.empty()){
-    trace.info()<<"Problem in discretisation.txt. First line shoulde be : dimX dimY"<<std::endl;
-  }else{
-    cols=std::stoi(subLine);
+  //files written before the pixel pitch option have one cell per mm
+  if(!(dimensionStream>>heightPitch>>arcPitch)){
+    heightPitch=1.;
+    arcPitch=1.;
   }
-  //trace.info()<<"cols "<<cols<<std::endl;
-  //trace.info()<<"rows "<<rows<<std::endl;
   //Here we want to read the number of rowcropped (second line of the file discretisation.txt)
   getline(infile, currentLine);
   if(currentLine.empty()){
@@ -121,31 +119,52 @@ void IOHelper::readDiscretisationFromFile(const std::string &fileName, std::vect
   }else{
     rowcroppedTop=std::stoi(subLine);
   }
-  //Here we want to fill input discretisation with value in discretisation.txt starting at the trhird line
-  //init dicretisation size with row and cols read before
-  discretisation.resize(rows);
-  for (int i = 0; i < rows; ++i){
-      discretisation[i].resize(cols);
-  }
-  //loop on other line in the discretisation.txt
-  size_t pos = 0;
-  //actual position to add in discretisation
-  int i=0,j=0;//i for cols and j for rows
-  //there are exactly the same number of line in discretisation.txt than the number of cels un discretisation
+  //the cells are stored column after column in the file : read them in this order,
+  //then count and copy them in row order
+  size_t nbCells=(size_t) rows*cols;
+  std::vector<unsigned int> fileOffsets(nbCells+1, 0);
+  std::vector<unsigned int> fileIndices;
+  size_t c=0;
   for (int i=0; i < cols; ++i){
     for (int j=0; j < rows; ++j){
       getline(infile, currentLine);
       std::stringstream linestream(currentLine);
       std::string value;
       while(getline(linestream,value,' ')){
-        if(std::stod(value)!=-1){
-          discretisation[j][i].push_back( std::stod(value));
+        if(!value.empty() && std::stod(value)!=-1){
+          fileIndices.push_back(std::stod(value));
         }
       }
+      fileOffsets[++c]=fileIndices.size();
     }
   }
+  discretisation.offsets.assign(nbCells+1, 0);
+  for (int j=0; j < rows; ++j){
+    for (int i=0; i < cols; ++i){
+      size_t fileCell=(size_t) i*rows+j;
+      size_t cell=(size_t) j*cols+i;
+      discretisation.offsets[cell+1]=discretisation.offsets[cell]+fileOffsets[fileCell+1]-fileOffsets[fileCell];
+    }
+  }
+  discretisation.indices.resize(fileIndices.size());
+  for (size_t fileCell=0; fileCell < nbCells; ++fileCell){
+    size_t cell=(fileCell%rows)*cols+fileCell/rows;
+    std::copy(fileIndices.begin()+fileOffsets[fileCell], fileIndices.begin()+fileOffsets[fileCell+1],
+              discretisation.indices.begin()+discretisation.offsets[cell]);
+  }
+}
 
-
+void IOHelper::writeTensorToFile(const std::vector<float> &tensor, unsigned int nbChannels, unsigned int nbRows, unsigned int nbCols,
+                                 unsigned int rowOffset, const std::string &fileName){
+  trace.info()<<"Writting tensor ..."<<std::endl;
+  //8 x 4 bytes, the data stays aligned for a mapping
+  uint32_t header[8]={0, 1, 1, nbChannels, nbRows, nbCols, rowOffset, 0};
+  memcpy(header, "RTSR", 4);
+  std::ofstream outStream;
+  outStream.open(fileName.c_str(), std::ofstream::out | std::ofstream::binary);
+  outStream.write((const char *) header, sizeof(header));
+  outStream.write((const char *) tensor.data(), tensor.size()*sizeof(float));
+  outStream.close();
 }
 
 void IOHelper::export2OFF(const Mesh<Z3i::RealPoint> &mesh, std::string fileName){
@@ -11,6 +11,8 @@
 #include "DGtal/io/writers/MeshWriter.h"
 #include "DGtal/shapes/Mesh.h"
 
+#include "CsrIndex.h"
+
 
 
 using namespace DGtal;
@@ -34,8 +36,21 @@ public:
     static void export2Text(const std::vector<std::pair<double, double> > &v, const std::string &filename);
     static void export2Text(const std::vector<DGtal::Z3i::RealPoint> &pointCloud,
             const std::vector<unsigned int> &indices, const std::string &filename);
-    static void writeDiscretisationToFile(const std::vector<std::vector<std::vector<unsigned int>>> &discretisation,const int &rowcroppedBot,const int &rowcroppedTop, const std::string &fileName);
-    static void readDiscretisationFromFile(const std::string &fileName, std::vector<std::vector<std::vector<unsigned int>>> &discretisation, int &rowcroppedBot, int &rowcroppedTop);
+    //discretisation : rows x cols cells in CSR, cell (j,i) is j*cols+i. Ind are written through ids when ids is not empty.
+    //First line is "rows cols heightPitch arcPitch", the pitches (mm per cell) are 1 when missing (older files)
+    static void writeDiscretisationToFile(const CsrIndex &discretisation,const int &rows,const int &cols,const double &heightPitch,const double &arcPitch,
+                                          const std::vector<unsigned int> &ids,const int &rowcroppedBot,const int &rowcroppedTop, const std::string &fileName);
+    static void readDiscretisationFromFile(const std::string &fileName, CsrIndex &discretisation, int &rows, int &cols, double &heightPitch, double &arcPitch,
+                                           int &rowcroppedBot, int &rowcroppedTop);
+    /**
+    write a float tensor (nbChannels x nbRows x nbCols, NCHW with N = 1) in a binary file that can be mapped :
+    header of 8 uint32 (magic "RTSR", version 1, N, C, H, W, rowOffset, 0) then the floats in native byte order.
+    rowOffset is the first row of the discretisation in the tensor.
+    For the relief tensor of UnrolledMap the channels are : relief max, relief mean, number of points of the
+    cell (not of the coarser block used to fill it), mean radius, fill level.
+    **/
+    static void writeTensorToFile(const std::vector<float> &tensor, unsigned int nbChannels, unsigned int nbRows, unsigned int nbCols,
+                                  unsigned int rowOffset, const std::string &fileName);
     static void readDistanceFromFile(const std::string &fileName, std::vector<double> &vectDistances);
 
     //not generic!!!!
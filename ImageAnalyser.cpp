@@ -40,6 +40,7 @@ ImageAnalyser::onMouse( int event, int x, int y, int flags, void* param)
         CylindricalPoint mpFound;
         unsigned int nbPatches=indInCells.size();
         std::string datafilename;
+        std::vector<unsigned int> pointsInPatch;
         double a,b;
         //fill  patches.dat files
         for (unsigned int idPatches = 0; idPatches < nbPatches; ++idPatches){
@@ -47,7 +48,8 @@ ImageAnalyser::onMouse( int event, int x, int y, int flags, void* param)
             datafilename="../clickedPatchOutput/    "+std::to_string(idPatches)+".dat";
             dataFile.open(datafilename);
             dataFile<<"#X\tY\n";
-            for(std::vector<unsigned int>::iterator it = std::begin(p_ianalyser->ind_Patches[indInCells[idPatches]]); it != std::end(p_ianalyser->ind_Patches[indInCells[idPatches]]); ++it) {
+            p_ianalyser->ind_Patches.decode(indInCells[idPatches], pointsInPatch);
+            for(std::vector<unsigned int>::iterator it = std::begin(pointsInPatch); it != std::end(pointsInPatch); ++it) {
                 IndP=*it;
                 
                 mpFound = p_ianalyser->CPoints.at(IndP);
@@ -65,7 +67,7 @@ ImageAnalyser::onMouse( int event, int x, int y, int flags, void* param)
         for (unsigned int idPatches = 0; idPatches < nbPatches; ++idPatches){
             IndP=indInCells[idPatches];
             mpFound = p_ianalyser->CPoints.at(IndP);
-            //shiftedPoint=p_ianalyser->getShiftedPoint(p_ianalyser->ind_CoefsLines.at(IndP),p_ianalyser->ind_Patches.at(IndP));
+            //shiftedPoint=p_ianalyser->getShiftedPoint(p_ianalyser->ind_CoefsLines.at(IndP),p_ianalyser->ind_Patches.getPatch(IndP));
             //std::cout<<"h:"<<mpFound.height<<"r: "<<mpFound.radius<<std::endl;
             fprintf(fp,"set output \"patch%d.png\"\n",idPatches);
 
@@ -6,13 +6,14 @@
 
 #include "UnrolledMap.h"
 #include "CylindricalPoint.h"
+#include "PatchMembership.h"
 
 class ImageAnalyser{
   public:
     /**
     Constructor.
    **/
-    ImageAnalyser(UnrolledMap uM, std::vector<std::vector<unsigned int>> pR,std::vector<CylindricalPoint> cP, std::vector<std::pair<double, double> > coefs):unrolled_map(uM),ind_Patches(pR),CPoints(cP),ind_CoefsLines(coefs)
+    ImageAnalyser(UnrolledMap uM, const PatchMembership &pR,std::vector<CylindricalPoint> cP, std::vector<std::pair<double, double> > coefs):unrolled_map(uM),ind_Patches(pR),CPoints(cP),ind_CoefsLines(coefs)
     {}
     /**
     display rgb image from unrolled map and allow user event
@@ -29,7 +30,8 @@ class ImageAnalyser{
     
 
 
-    std::vector<std::vector<unsigned int>> ind_Patches;
+    //points of the patch of each point, decoded when clicked
+    PatchMembership ind_Patches;
 
     UnrolledMap unrolled_map;
     
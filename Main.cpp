@@ -22,6 +22,7 @@
 
 #include "DefectSegmentation.h"
 #include "IOHelper.h"
+#include "Regression.h"
 #include "Centerline/Centerline.h"
 #include "Centerline/CenterlineHelper.h"
 
@@ -46,8 +47,14 @@ main(int argc,char **argv)
         ("trackStep,s", po::value<double>(), "tracking step.")
         ("invertNormal,n", "invert normal to apply accumulation.")
         ("binWidth,b", po::value<double>()->default_value(5.0), "bin width used to compute threshold")
+        ("thresholdMethod", po::value<std::string>()->default_value("rosin"), "threshold of the distances : rosin or otsu")
+        ("tileThreshold", po::value<double>()->default_value(0.0), "size (mm) of the tiles of local thresholds, smoothed and interpolated per point (0 : one global threshold)")
+        ("dumpHistogram", "write the histogram of the distances (hist2d) and the Rosin construction (pointFile)")
         ("patchWidth,a", po::value<double>()->default_value(25), "Arc length/ width of patch")
         ("patchHeight,e", po::value<int>()->default_value(100), "Height of patch")
+        ("spatialReorder", "reorder the points along a Hilbert curve on (height, angle) to improve memory locality.")
+        ("adaptivePatch", "angular width of the patches from the mean radius of each centerline segment instead of the whole log")
+        ("maxPatchPoints", po::value<unsigned int>()->default_value(0), "maximum number of points per patch, even subsample above (0 : no limit)")
         ("voxelSize", po::value<int>()->default_value(1), "Voxel size")
         ("output,o", po::value<std::string>()->default_value("output"), "output prefix: output-defect.off, output-def-faces-ids, ...");
 
@@ -144,6 +151,23 @@ trace.info()<<"pointcloud:"<<pointCloud.size()<<std::endl;
     std::vector<unsigned int> noDefectCloudIndices;
 
     DefectSegmentation sa(pointCloud, centerline, patchWidth, patchHeight, binWidth);
+    sa.setSpatialReorder(vm.count("spatialReorder"));
+    sa.setAdaptivePatch(vm.count("adaptivePatch"));
+    unsigned int maxPatchPoints = vm["maxPatchPoints"].as<unsigned int>();
+    if(maxPatchPoints > 0 && maxPatchPoints < MIN_NB_POINTS){
+        trace.error()<<"maxPatchPoints must be 0 or at least "<<MIN_NB_POINTS<<" (the minimum number of points of a fit)"<<std::endl;
+        return 1;
+    }
+    sa.setMaxPatchPoints(maxPatchPoints);
+    std::string thresholdMethod = vm["thresholdMethod"].as<std::string>();
+    if(thresholdMethod == "otsu"){
+        sa.setThresholdMethod(OTSU_THRESHOLD);
+    }else if(thresholdMethod != "rosin"){
+        trace.error()<<"unknown threshold method : "<<thresholdMethod<<std::endl;
+        return 1;
+    }
+    sa.setThresholdDump(vm.count("dumpHistogram"));
+    sa.setTileThreshold(vm["tileThreshold"].as<double>());
 
     sa.init();
     std::vector<unsigned int> defects = sa.getDefect();
@@ -22,6 +22,7 @@
 
 #include "DefectSegmentationUnroll.h"
 #include "IOHelper.h"
+#include "Regression.h"
 #include "Centerline/Centerline.h"
 #include "Centerline/CenterlineHelper.h"
 
@@ -51,8 +52,19 @@ main(int argc,char **argv)
         ("binWidth,b", po::value<double>()->default_value(0.01), "bin width used to compute threshold")
         ("patchWidth,a", po::value<double>()->default_value(25), "Arc length/ width of patch")
         ("patchHeight,e", po::value<int>()->default_value(100), "Height of patch")
+        ("spatialReorder", "reorder the points along a Hilbert curve on (height, angle) to improve memory locality.")
+        ("adaptivePatch", "angular width of the patches from the mean radius of each centerline segment instead of the whole log")
+        ("maxPatchPoints", po::value<unsigned int>()->default_value(0), "maximum number of points per patch, even subsample above (0 : no limit)")
+        ("patchEngine", po::value<std::string>()->default_value("exact"), "engine of patch regression : exact, prefix (O(1) per point from prefix sums of (height, angle) bins) or lattice (fits on a coarse lattice, interpolated)")
+        ("patchKernel", po::value<std::string>()->default_value("purged"), "regression of the patches of the exact and lattice engines : purged (least squares without outliers, RANSAC on noisy patches) or robust (IRLS with the fair weight function)")
+        ("latticeStep", po::value<double>()->default_value(5.0), "spacing (mm) of the lattice nodes of the lattice patch engine")
+        ("recordPatches", "record the points of the patch of each point (inspection only, costs memory, exact patch engine only)")
+        ("compareEngines", "also run the exact patch engine and report timings and reference radius deviation")
         ("voxelSize", po::value<int>()->default_value(5), "Voxel size")
         ("decreaseFactor,d", po::value<int>()->default_value(4), "Max decrease factor for multi resolution search")
+        ("pixelPitch", po::value<std::vector<double> >()->multitoken(), "size (mm) of a pixel of the relief map : heightPitch [arcPitch], arcPitch = heightPitch if omitted (default 1 1)")
+        ("reliefTensor", "also write output.tensor : relief max, relief mean, count, radius and fill level channels (float NCHW with a header)")
+        ("reliefReducer", po::value<std::string>()->default_value("max"), "reduction of the relief of the points of a cell : max, mean, sum, median, count, p10 or p90 (percentiles)")
         ("grayscaleOrigin", po::value<int>()->default_value(-5), "relief value for 0 level in grayscale intensity")
         ("intensityPerCm", po::value<int>()->default_value(10), "number of grayscale intensity to represente 1cm of relief")
         ("output,o", po::value<std::string>()->default_value("output"), "output prefix: output-defect.off, output-def-faces-ids, ...");
@@ -154,6 +166,61 @@ main(int argc,char **argv)
 
 
     DefectSegmentationUnroll sa(pointCloud,centerline,patchWidth,patchHeight,binWidth);
+    sa.setSpatialReorder(vm.count("spatialReorder"));
+    sa.setAdaptivePatch(vm.count("adaptivePatch"));
+    unsigned int maxPatchPoints = vm["maxPatchPoints"].as<unsigned int>();
+    if(maxPatchPoints > 0 && maxPatchPoints < MIN_NB_POINTS){
+        trace.error()<<"maxPatchPoints must be 0 or at least "<<MIN_NB_POINTS<<" (the minimum number of points of a fit)"<<std::endl;
+        return 1;
+    }
+    sa.setMaxPatchPoints(maxPatchPoints);
+    std::string patchEngine = vm["patchEngine"].as<std::string>();
+    if(patchEngine == "prefix"){
+        sa.setPatchEngine(PREFIX_SUM_PATCH, vm.count("compareEngines"));
+    }else if(patchEngine == "lattice"){
+        sa.setPatchEngine(LATTICE_PATCH, vm.count("compareEngines"));
+        if(vm["latticeStep"].as<double>() <= 0){
+            trace.error()<<"latticeStep must be positive"<<std::endl;
+            return 1;
+        }
+        sa.setLatticeStep(vm["latticeStep"].as<double>());
+    }else if(patchEngine == "exact"){
+        sa.setPatchEngine(EXACT_PATCH, vm.count("compareEngines"));
+    }else{
+        trace.error()<<"unknown patch engine : "<<patchEngine<<std::endl;
+        return 1;
+    }
+    std::string patchKernel = vm["patchKernel"].as<std::string>();
+    if(patchKernel == "robust"){
+        if(patchEngine == "prefix"){
+            trace.error()<<"the robust patch kernel needs the exact or the lattice patch engine"<<std::endl;
+            return 1;
+        }
+        sa.setPatchKernel(ROBUST_KERNEL);
+    }else if(patchKernel != "purged"){
+        trace.error()<<"unknown patch kernel : "<<patchKernel<<std::endl;
+        return 1;
+    }
+    if(vm.count("recordPatches") && patchEngine != "exact"){
+        trace.error()<<"recordPatches needs the exact patch engine"<<std::endl;
+        return 1;
+    }
+    sa.setRecordPatches(vm.count("recordPatches"));
+    ReliefReduction reliefReduction;
+    if(!parseReliefReduction(vm["reliefReducer"].as<std::string>(), reliefReduction)){
+        trace.error()<<"unknown relief reducer : "<<vm["reliefReducer"].as<std::string>()<<std::endl;
+        return 1;
+    }
+    sa.setReliefReduction(reliefReduction);
+    sa.setReliefTensor(vm.count("reliefTensor"));
+    if(vm.count("pixelPitch")){
+        std::vector<double> pixelPitch = vm["pixelPitch"].as<std::vector<double> >();
+        if(pixelPitch.empty() || pixelPitch.size() > 2 || pixelPitch.front() <= 0 || pixelPitch.back() <= 0){
+            trace.error()<<"pixelPitch expects one or two positive values"<<std::endl;
+            return 1;
+        }
+        sa.setPixelPitch(pixelPitch.front(), pixelPitch.back());
+    }
     sa.init();
     sa.makeRM(outputPrefix,GtFileName, maxDecreaseFactor,gs_origin,intensity_cm);
 
@@ -9,6 +9,17 @@
 #include <unistd.h>
 #endif
 
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+
 static int getNumCores() {
 #ifdef WIN32
     SYSTEM_INFO sysinfo;
@@ -33,4 +44,234 @@ static int getNumCores() {
 #endif
 }
 
+//default number of points per chunk for the per point stages
+#define PARALLEL_GRAIN 4096
+//number of points per chunk for the patch regression stage (costly per point)
+#define PATCH_GRAIN 64
+
+/**
+ * Pool of persistent worker threads shared by all the parallel stages.
+ * The work of a parallelFor is split in chunks whose boundaries only depend on
+ * the range and on the grain, never on the number of threads, so that per chunk
+ * results (counts, partial sums) are combined in a deterministic order.
+ * Each participating thread first receives a contiguous run of chunks, takes
+ * them from the front and, once its run is exhausted, steals chunks from the
+ * back of the other runs. The calling thread takes part to the work, nested
+ * calls are allowed.
+ * The time spent in chunks is accumulated per worker (id 0 is any thread
+ * which is not a worker of the pool, usually the main thread).
+ **/
+class ThreadPool{
+    public:
+        /**
+        return the pool shared by the whole program (one thread per core)
+        **/
+        static ThreadPool &getInstance(){
+            static ThreadPool pool(getNumCores());
+            return pool;
+        }
+
+        /**
+        Constructor. nbThreads counts the calling thread, so nbThreads - 1 workers are started.
+        **/
+        explicit ThreadPool(int nbThreads): stop(false), busyTimes(std::max(nbThreads, 1)){
+            resetBusyTimes();
+            for(int i = 0; i < nbThreads - 1; i++){
+                workers.push_back(std::thread(&ThreadPool::workerLoop, this, i + 1));
+            }
+        }
+
+        ~ThreadPool(){
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                stop = true;
+            }
+            queueCondition.notify_all();
+            for(unsigned int i = 0; i < workers.size(); i++){
+                workers[i].join();
+            }
+        }
+
+        /**
+        return the number of threads working on a parallelFor (workers + calling thread)
+        **/
+        int getNbThreads() const {
+            return workers.size() + 1;
+        }
+
+        /**
+        return the number of chunks used by parallelFor on [begin, end[ with chunks of grain elements
+        **/
+        static size_t getNbChunks(size_t begin, size_t end, size_t grain){
+            return end > begin ? (end - begin + grain - 1) / grain : 0;
+        }
+
+        /**
+        call f(chunkId, chunkBegin, chunkEnd) on every chunk of grain elements of [begin, end[
+        and return when all chunks are done.
+        **/
+        template<typename F>
+        void parallelFor(size_t begin, size_t end, size_t grain, const F &f){
+            size_t nbChunks = getNbChunks(begin, end, grain);
+            if(nbChunks == 0){
+                return;
+            }
+            std::function<void(size_t)> runChunk = [&f, begin, end, grain](size_t c){
+                f(c, begin + c*grain, std::min(end, begin + (c + 1)*grain));
+            };
+            size_t nbHelpers = std::min(workers.size(), nbChunks - 1);
+            //state shared with the helpers, may outlive this call if a helper starts late
+            std::shared_ptr<Job> job = std::make_shared<Job>(nbChunks, nbHelpers + 1, &runChunk);
+            if(nbHelpers > 0){
+                std::unique_lock<std::mutex> lock(queueMutex);
+                for(size_t i = 0; i < nbHelpers; i++){
+                    tasks.push_back([this, job](){ work(*job); });
+                }
+            }
+            queueCondition.notify_all();
+            work(*job);
+            job->wait();
+        }
+
+        /**
+        return the sum (operator+ from init) of f(chunkBegin, chunkEnd) over the chunks of [begin, end[,
+        partial results are added in chunk order.
+        **/
+        template<typename T, typename F>
+        T parallelReduce(size_t begin, size_t end, size_t grain, T init, const F &f){
+            std::vector<T> partials(getNbChunks(begin, end, grain), init);
+            parallelFor(begin, end, grain, [&](size_t c, size_t lo, size_t hi){
+                partials[c] = f(lo, hi);
+            });
+            T result = init;
+            for(unsigned int c = 0; c < partials.size(); c++){
+                result = result + partials[c];
+            }
+            return result;
+        }
+
+        /**
+        return the time (ms) spent in chunks by each worker since the last reset (index 0 for the other threads)
+        **/
+        std::vector<double> getBusyTimes() const {
+            std::vector<double> times(busyTimes.size());
+            for(unsigned int i = 0; i < busyTimes.size(); i++){
+                times[i] = busyTimes[i] / 1e6;
+            }
+            return times;
+        }
+
+        void resetBusyTimes(){
+            for(unsigned int i = 0; i < busyTimes.size(); i++){
+                busyTimes[i] = 0;
+            }
+        }
+
+    private:
+        //contiguous run of chunks [front, back[ owned by one participant
+        struct Run{
+            std::mutex mutex;
+            size_t front;
+            size_t back;
+        };
+
+        struct Job{
+            Job(size_t n, size_t nbRuns, const std::function<void(size_t)> *f):
+                nbChunks(n), runs(nbRuns), nextRun(0), nbDone(0), runChunk(f){
+                for(size_t r = 0; r < nbRuns; r++){
+                    runs[r].front = n * r / nbRuns;
+                    runs[r].back = n * (r + 1) / nbRuns;
+                }
+            }
+            //take a chunk from the front of run r, return false if empty
+            bool pop(size_t r, size_t &c){
+                std::unique_lock<std::mutex> lock(runs[r].mutex);
+                if(runs[r].front >= runs[r].back){
+                    return false;
+                }
+                c = runs[r].front++;
+                return true;
+            }
+            //take a chunk from the back of run r, return false if empty
+            bool steal(size_t r, size_t &c){
+                std::unique_lock<std::mutex> lock(runs[r].mutex);
+                if(runs[r].front >= runs[r].back){
+                    return false;
+                }
+                c = --runs[r].back;
+                return true;
+            }
+            void wait(){
+                std::unique_lock<std::mutex> lock(doneMutex);
+                doneCondition.wait(lock, [this](){ return nbDone == nbChunks; });
+            }
+            size_t nbChunks;
+            std::vector<Run> runs;
+            std::atomic<size_t> nextRun;
+            std::atomic<size_t> nbDone;
+            const std::function<void(size_t)> *runChunk;
+            std::mutex doneMutex;
+            std::condition_variable doneCondition;
+        };
+
+        //id of the worker running the current thread, 0 if not a worker
+        static int &currentWorkerId(){
+            static thread_local int id = 0;
+            return id;
+        }
+
+        //run chunks of the job until none is left, first from its own run then by stealing
+        void work(Job &job){
+            size_t myRun = job.nextRun++;
+            if(myRun >= job.runs.size()){
+                return;
+            }
+            auto startTime = std::chrono::steady_clock::now();
+            size_t nbLocalDone = 0;
+            size_t c;
+            while(job.pop(myRun, c)){
+                (*job.runChunk)(c);
+                nbLocalDone++;
+            }
+            for(size_t k = 1; k < job.runs.size(); k++){
+                size_t victim = (myRun + k) % job.runs.size();
+                while(job.steal(victim, c)){
+                    (*job.runChunk)(c);
+                    nbLocalDone++;
+                }
+            }
+            busyTimes[currentWorkerId()] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - startTime).count();
+            if(nbLocalDone > 0 && (job.nbDone += nbLocalDone) == job.nbChunks){
+                std::unique_lock<std::mutex> lock(job.doneMutex);
+                job.doneCondition.notify_all();
+            }
+        }
+
+        void workerLoop(int workerId){
+            currentWorkerId() = workerId;
+            for(;;){
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueCondition.wait(lock, [this](){ return stop || !tasks.empty(); });
+                    if(stop && tasks.empty()){
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()> > tasks;
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        bool stop;
+        //nanoseconds spent in chunks by each worker
+        std::vector<std::atomic<long long> > busyTimes;
+};
+
 #endif//MULTI_THREAD_HELPER_H
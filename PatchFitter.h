@@ -0,0 +1,287 @@
+#ifndef PATCH_FITTER_H
+#define PATCH_FITTER_H
+
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+
+#include "DGtal/helpers/StdDefs.h"
+#include <pcl/point_types.h>
+#include <pcl/kdtree/kdtree_flann.h>
+
+#include "CylindricalPoint.h"
+#include "CylindricalGrid.h"
+#include "PatchScratch.h"
+#include "Regression.h"
+#include "MultiThreadHelper.h"
+#include "AllocationCounter.h"
+
+/**
+ * Patch regression of every point, shared by the segmentation methods.
+ * The two steps are compile time parameters, so the inner loop is inlined :
+ *  - QueryPolicy::gather(idPoint, maxCandidates, scratch) fills scratch.xs (heights), scratch.ys (radii)
+ *    and scratch.indices with the points of the patch of idPoint,
+ *  - FitKernel::fit(xs, ys, indices, seed, scratch) returns the line (slope, intercept).
+ * The patches are gathered in the PatchScratch of the worker, the seed of a point is its
+ * index in the input mesh so the result does not depend on the threads or on the point order.
+ **/
+template<typename QueryPolicy, typename FitKernel>
+class PatchFitter{
+    public:
+        /**
+        originalIds : index in the input mesh of each point (empty if the points were not reordered)
+        **/
+        PatchFitter(const QueryPolicy &aQuery, const FitKernel &aKernel, const std::vector<unsigned int> &anOriginalIds):
+            query(aQuery), kernel(aKernel), originalIds(anOriginalIds){}
+
+        /**
+        keep at most maxPoints points per patch (0 : all). The query strides its enumeration
+        to about maxPoints points when it can, subsample caps what is left evenly.
+        **/
+        void setMaxPoints(unsigned int maxPoints){
+            maxPatchPoints = maxPoints;
+        }
+
+        /**
+        line of the patch of idPoint, the patch is left in PatchScratch::local()
+        **/
+        std::pair<double, double> fit(unsigned int idPoint) const {
+            PatchScratch &scratch = PatchScratch::local();
+            gatherPatch(scratch, [&](unsigned int maxCandidates){
+                query.gather(idPoint, maxCandidates, scratch);
+            });
+            return kernel.fit(scratch.xs, scratch.ys, scratch.indices, getSeed(idPoint), scratch);
+        }
+
+        /**
+        line of the patch centered on (height, angle) (QueryPolicy::gatherAt)
+        **/
+        std::pair<double, double> fitAt(double height, double angle, uint64_t seed) const {
+            PatchScratch &scratch = PatchScratch::local();
+            gatherPatch(scratch, [&](unsigned int maxCandidates){
+                query.gatherAt(height, angle, maxCandidates, scratch);
+            });
+            return kernel.fit(scratch.xs, scratch.ys, scratch.indices, seed, scratch);
+        }
+
+        /**
+        fit the points of [begin, end[ on the thread pool and store the lines in coefficients.
+        onFit(chunkId, idPoint, scratch) is called after each fit.
+        Return the number of heap allocations done by the loop, 0 when they are not counted
+        (see AllocationCounter::isEnabled).
+        **/
+        template<typename OnFit>
+        unsigned long long run(size_t begin, size_t end, size_t grain,
+                               std::vector<std::pair<double, double> > &coefficients, const OnFit &onFit) const {
+            std::atomic<unsigned long long> nbAllocations(0);
+            ThreadPool::getInstance().parallelFor(begin, end, grain, [&](size_t chunkId, size_t lo, size_t hi){
+                unsigned long long before = AllocationCounter::getThreadCount();
+                for(size_t i = lo; i < hi; i++){
+                    coefficients[i] = fit(i);
+                    onFit(chunkId, i, PatchScratch::local());
+                }
+                nbAllocations += AllocationCounter::getThreadCount() - before;
+            });
+            return nbAllocations;
+        }
+
+        unsigned long long run(size_t begin, size_t end, size_t grain, std::vector<std::pair<double, double> > &coefficients) const {
+            return run(begin, end, grain, coefficients, [](size_t, size_t, PatchScratch &){});
+        }
+
+    protected:
+        uint64_t getSeed(unsigned int idPoint) const {
+            return originalIds.empty() ? idPoint : originalIds[idPoint];
+        }
+
+        /**
+        fill scratch with the patch : gather(maxCandidates) strided to about maxPatchPoints, gathered
+        again whole when the stride left less than MIN_NB_POINTS points (estimate too low, sparse
+        patch), then capped by subsample.
+        **/
+        template<typename Gather>
+        void gatherPatch(PatchScratch &scratch, const Gather &gather) const {
+            scratch.reset();
+            gather(maxPatchPoints);
+            if(maxPatchPoints > 0 && scratch.xs.size() < MIN_NB_POINTS){
+                scratch.reset();
+                gather(0);
+            }
+            subsample(scratch);
+        }
+
+        /**
+        keep maxPatchPoints points of the patch at an even stride, in place. The queries
+        enumerate the points by bucket or by distance, so a stride covers the whole patch.
+        **/
+        void subsample(PatchScratch &scratch) const {
+            size_t n = scratch.xs.size();
+            if(maxPatchPoints == 0 || n <= maxPatchPoints){
+                return;
+            }
+            //k * n / maxPatchPoints >= k : the copy never overwrites a point not read yet
+            for(size_t k = 0; k < maxPatchPoints; k++){
+                size_t from = k * n / maxPatchPoints;
+                scratch.xs[k] = scratch.xs[from];
+                scratch.ys[k] = scratch.ys[from];
+                scratch.indices[k] = scratch.indices[from];
+            }
+            scratch.xs.resize(maxPatchPoints);
+            scratch.ys.resize(maxPatchPoints);
+            scratch.indices.resize(maxPatchPoints);
+        }
+
+        QueryPolicy query;
+        FitKernel kernel;
+        const std::vector<unsigned int> &originalIds;
+        unsigned int maxPatchPoints = 0;
+};
+
+
+/**
+ * Patch of the unroll method : height window x angular window, enumerated from the (height, angle) buckets.
+ * The angular window of a point is the one of its segment, gatherAt uses patchAngle.
+ **/
+class GridPatchQuery{
+    public:
+        GridPatchQuery(const CylindricalGrid &aGrid, const std::vector<CylindricalPoint> &somePoints,
+                       double aPatchHeight, double aPatchAngle, const std::vector<double> &someSegmentPatchAngles):
+            grid(aGrid), points(somePoints), patchHeight(aPatchHeight), patchAngle(aPatchAngle),
+            segmentPatchAngles(someSegmentPatchAngles){}
+
+        /**
+        maxCandidates : the buckets of the patch are strided to about maxCandidates points of the window (0 : all),
+        see CylindricalGrid::forEachInPatch
+        **/
+        void gather(unsigned int idPoint, unsigned int maxCandidates, PatchScratch &scratch) const {
+            const CylindricalPoint &p = points[idPoint];
+            gatherAt(p.height, p.angle, segmentPatchAngles[p.segmentId], maxCandidates, scratch);
+        }
+
+        void gatherAt(double height, double angle, unsigned int maxCandidates, PatchScratch &scratch) const {
+            gatherAt(height, angle, patchAngle, maxCandidates, scratch);
+        }
+
+        void gatherAt(double height, double angle, double windowAngle, unsigned int maxCandidates, PatchScratch &scratch) const {
+            grid.forEachInPatch(height, angle, patchHeight / 2.0, windowAngle / 2, maxCandidates,
+                                [&](unsigned int foundedIndex, double foundHeight, double){
+                scratch.ys.push_back(points[foundedIndex].radius);
+                scratch.xs.push_back(foundHeight);
+                scratch.indices.push_back(foundedIndex);
+            });
+        }
+
+    protected:
+        const CylindricalGrid &grid;
+        const std::vector<CylindricalPoint> &points;
+        double patchHeight;
+        double patchAngle;
+        const std::vector<double> &segmentPatchAngles;
+};
+
+
+/**
+ * Patch of the Van Tho method : ball of the kd-tree, radius patchHeight / 2 + 1 enlarged near the
+ * ends of the log, then filtered on the angular window of the segment of the point
+ **/
+class KdTreeBallQuery{
+    public:
+        KdTreeBallQuery(const pcl::KdTreeFLANN<pcl::PointXYZ> &aKdtree, const std::vector<DGtal::Z3i::RealPoint> &aCloud,
+                        const std::vector<CylindricalPoint> &somePoints, double aPatchHeight,
+                        const std::vector<double> &someSegmentPatchAngles, double aMinHeight, double aMaxHeight):
+            kdtree(aKdtree), pointCloud(aCloud), points(somePoints), patchHeight(aPatchHeight),
+            segmentPatchAngles(someSegmentPatchAngles), minHeight(aMinHeight), maxHeight(aMaxHeight){}
+
+        /**
+        the radius search visits the whole ball anyway : every point of the angular window is kept
+        whatever maxCandidates, PatchFitter::subsample caps the patch.
+        **/
+        void gather(unsigned int idPoint, unsigned int, PatchScratch &scratch) const {
+            const DGtal::Z3i::RealPoint &currentPoint = pointCloud[idPoint];
+            const CylindricalPoint &mpCurrent = points[idPoint];
+            double patchAngle = segmentPatchAngles[mpCurrent.segmentId];
+            pcl::PointXYZ searchPoint(currentPoint[0], currentPoint[1], currentPoint[2]);
+
+            double searchRadius = patchHeight / 2 + 1;
+            if(mpCurrent.height - minHeight < patchHeight /2){
+                searchRadius += mpCurrent.height - minHeight;
+            }else if(maxHeight - mpCurrent.height < patchHeight/2){
+                searchRadius += maxHeight - mpCurrent.height;
+            }
+            if(kdtree.radiusSearch(searchPoint, searchRadius, scratch.searchIndices, scratch.searchDistances) > 0){
+                for(unsigned int idx = 0; idx < scratch.searchIndices.size(); ++idx){
+                    //index of dgtal and pcl is the same
+                    unsigned int foundedIndex = scratch.searchIndices[idx];
+                    const CylindricalPoint &mpFound = points[foundedIndex];
+                    double angleDiff = std::abs(mpFound.angle - mpCurrent.angle);
+                    if(angleDiff > patchAngle/2 && 2*M_PI - angleDiff > patchAngle / 2){
+                        continue;
+                    }
+                    scratch.ys.push_back(mpFound.radius);
+                    scratch.xs.push_back(mpFound.height);
+                    scratch.indices.push_back(foundedIndex);
+                }
+            }
+        }
+
+    protected:
+        const pcl::KdTreeFLANN<pcl::PointXYZ> &kdtree;
+        const std::vector<DGtal::Z3i::RealPoint> &pointCloud;
+        const std::vector<CylindricalPoint> &points;
+        double patchHeight;
+        const std::vector<double> &segmentPatchAngles;
+        double minHeight;
+        double maxHeight;
+};
+
+
+/**
+ * Regression::linearRegression (Van Tho method)
+ **/
+struct LinearRegressionKernel{
+    std::pair<double, double> fit(Span<const double> xs, Span<const double> ys, Span<const unsigned int>,
+                                  uint64_t seed, PatchScratch &scratch) const {
+        return Regression::linearRegression(xs, ys, seed, scratch);
+    }
+    //points of the patch used by the fit
+    static std::vector<unsigned int> &getFitPoints(PatchScratch &scratch){
+        return scratch.indices;
+    }
+};
+
+
+/**
+ * Regression::PurgedlinearRegression (unroll method), the points kept are left in scratch.selected
+ **/
+struct PurgedRegressionKernel{
+    std::pair<double, double> fit(Span<const double> xs, Span<const double> ys, Span<const unsigned int> indices,
+                                  uint64_t seed, PatchScratch &scratch) const {
+        return Regression::PurgedlinearRegression(xs, ys, indices, seed, scratch);
+    }
+    static std::vector<unsigned int> &getFitPoints(PatchScratch &scratch){
+        return scratch.selected;
+    }
+};
+
+
+/**
+ * Regression::robustLinear (IRLS with the fair weight function)
+ **/
+struct RobustRegressionKernel{
+    std::pair<double, double> fit(Span<const double> xs, Span<const double> ys, Span<const unsigned int>,
+                                  uint64_t, PatchScratch &scratch) const {
+        if(ys.size() < MIN_NB_POINTS){
+            return std::pair<double, double>(0., 0.);
+        }
+        return Regression::robustLinear(xs, ys, scratch);
+    }
+    //all the points are used, with their weights
+    static std::vector<unsigned int> &getFitPoints(PatchScratch &scratch){
+        return scratch.indices;
+    }
+};
+
+#endif // PATCH_FITTER_H
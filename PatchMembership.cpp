@@ -0,0 +1,113 @@
+#include <algorithm>
+
+#include "PatchMembership.h"
+
+static inline void
+writeVarint(std::vector<uint8_t> &out, unsigned int value){
+    while(value >= 0x80){
+        out.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t) value);
+}
+
+
+void
+PatchMembership::beginBuild(size_t nbPatches, size_t nbChunks){
+    offsets.clear();
+    bytes.clear();
+    nbIndices = 0;
+    chunkBytes.assign(nbChunks, std::vector<uint8_t>());
+    chunkIndices.assign(nbChunks, 0);
+    patchSizes.assign(nbPatches, 0);
+}
+
+
+void
+PatchMembership::append(size_t chunkId, unsigned int patchId, unsigned int *indices, size_t n){
+    std::sort(indices, indices + n);
+    std::vector<uint8_t> &out = chunkBytes[chunkId];
+    size_t before = out.size();
+    unsigned int previous = 0;
+    for(size_t i = 0; i < n; i++){
+        writeVarint(out, indices[i] - previous);
+        previous = indices[i];
+    }
+    patchSizes[patchId] = out.size() - before;
+    chunkIndices[chunkId] += n;
+}
+
+
+void
+PatchMembership::finishBuild(){
+    offsets.assign(patchSizes.size() + 1, 0);
+    for(size_t p = 0; p < patchSizes.size(); p++){
+        offsets[p + 1] = offsets[p] + patchSizes[p];
+    }
+    bytes.clear();
+    bytes.reserve(offsets.back());
+    for(size_t c = 0; c < chunkBytes.size(); c++){
+        bytes.insert(bytes.end(), chunkBytes[c].begin(), chunkBytes[c].end());
+        nbIndices += chunkIndices[c];
+    }
+    //release the build state
+    std::vector<std::vector<uint8_t> >().swap(chunkBytes);
+    std::vector<size_t>().swap(chunkIndices);
+    std::vector<unsigned int>().swap(patchSizes);
+}
+
+
+void
+PatchMembership::decode(unsigned int patchId, std::vector<unsigned int> &indices) const {
+    indices.clear();
+    if(patchId + 1 >= offsets.size()){
+        return;
+    }
+    unsigned int previous = 0;
+    size_t k = offsets[patchId];
+    size_t end = offsets[patchId + 1];
+    while(k < end){
+        unsigned int delta = 0;
+        int shift = 0;
+        uint8_t b;
+        do{
+            b = bytes[k++];
+            delta |= (unsigned int) (b & 0x7f) << shift;
+            shift += 7;
+        }while(b & 0x80);
+        previous += delta;
+        indices.push_back(previous);
+    }
+}
+
+
+std::vector<unsigned int>
+PatchMembership::getPatch(unsigned int patchId) const {
+    std::vector<unsigned int> indices;
+    decode(patchId, indices);
+    return indices;
+}
+
+
+size_t
+PatchMembership::getNbPatches() const {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+}
+
+
+bool
+PatchMembership::empty() const {
+    return offsets.empty();
+}
+
+
+size_t
+PatchMembership::getNbBytes() const {
+    return bytes.size() + offsets.size() * sizeof(size_t);
+}
+
+
+size_t
+PatchMembership::getNbIndices() const {
+    return nbIndices;
+}
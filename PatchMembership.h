@@ -0,0 +1,58 @@
+#ifndef PATCH_MEMBERSHIP_H
+#define PATCH_MEMBERSHIP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Compressed storage of the point indices of each patch (for inspection, see ImageAnalyser).
+ * CSR layout : the bytes of patch p are bytes[offsets[p]] ... bytes[offsets[p+1] - 1].
+ * The indices of a patch are sorted, the first one and then the differences between
+ * consecutive ones are written as varints (7 bits per byte, high bit = more bytes follow).
+ *
+ * Built from the chunks of the thread pool : each chunk appends its patches in increasing
+ * patch order to its own buffer, and the chunks cover increasing ranges of patches,
+ * so finishBuild() only has to concatenate them.
+ **/
+class PatchMembership{
+    public:
+        PatchMembership(){}
+
+        /**
+        start a build of nbPatches patches (all empty) from at most nbChunks chunks
+        **/
+        void beginBuild(size_t nbPatches, size_t nbChunks);
+        /**
+        record the indices of patch patchId from the chunk chunkId, the indices are sorted in place
+        **/
+        void append(size_t chunkId, unsigned int patchId, unsigned int *indices, size_t n);
+        /**
+        concatenate the chunks, the storage is then ready to be read
+        **/
+        void finishBuild();
+
+        /**
+        indices of patch patchId (in increasing order)
+        **/
+        void decode(unsigned int patchId, std::vector<unsigned int> &indices) const;
+        std::vector<unsigned int> getPatch(unsigned int patchId) const;
+
+        size_t getNbPatches() const;
+        bool empty() const;
+        //size of the compressed storage, offsets included
+        size_t getNbBytes() const;
+        //number of indices stored
+        size_t getNbIndices() const;
+
+    protected:
+        std::vector<size_t> offsets;
+        std::vector<uint8_t> bytes;
+        size_t nbIndices = 0;
+        //build state
+        std::vector<std::vector<uint8_t> > chunkBytes;
+        std::vector<size_t> chunkIndices;
+        std::vector<unsigned int> patchSizes;
+};
+
+#endif // PATCH_MEMBERSHIP_H
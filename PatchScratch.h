@@ -0,0 +1,47 @@
+#ifndef PATCH_SCRATCH_H
+#define PATCH_SCRATCH_H
+
+#include <vector>
+
+/**
+ * Per thread buffers of the patch regression. reset() only clears them so that
+ * once they reached the size of the largest patch, a point is processed without
+ * any heap allocation. Use PatchScratch::local() to get the buffers of the calling thread.
+ **/
+struct PatchScratch{
+    //points of the patch
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::vector<unsigned int> indices;
+    //kd-tree query results
+    std::vector<int> searchIndices;
+    std::vector<float> searchDistances;
+    //points kept by the outlier filter
+    std::vector<double> inXs;
+    std::vector<double> inYs;
+    std::vector<unsigned int> selected;
+    //inliers of RANSAC
+    std::vector<double> ransacXs;
+    std::vector<double> ransacYs;
+    //distances to the line for the median shift
+    std::vector<double> distances;
+    //weights, residuals and leverage factors of the robust fits (grow only, not cleared by reset)
+    std::vector<double> weights;
+    std::vector<double> residuals;
+    std::vector<double> leverages;
+
+    void reset(){
+        xs.clear(); ys.clear(); indices.clear();
+        searchIndices.clear(); searchDistances.clear();
+        inXs.clear(); inYs.clear(); selected.clear();
+        ransacXs.clear(); ransacYs.clear();
+        distances.clear();
+    }
+
+    static PatchScratch &local(){
+        static thread_local PatchScratch scratch;
+        return scratch;
+    }
+};
+
+#endif // PATCH_SCRATCH_H
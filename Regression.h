@@ -2,102 +2,60 @@
 #define REGRESSION_H
 
 #include <utility>
+#include <algorithm>
 #include <vector>
 #include <cassert>
 #include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <climits>
+#include <limits>
+#include <cstdint>
 
-#include <eigen3/Eigen/Dense>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "Statistic.h"
-#include <gsl/gsl_multifit.h>
+#include "Span.h"
+#include "PatchScratch.h"
 
 
 #define MAX_SD 1000
 #define MIN_NB_POINTS 10
 #define EPS 1
-
-struct coefs
-{
-    std::pair<double, double> coefficients;
-    std::vector<unsigned int> ind_p;
-
-};
+//hard cap on the samples drawn by RANSAC, rejected samples included
+#define RANSAC_MAX_SAMPLES 10000
+//iterations of the robust fit and tuning constant of the fair weight function (values of gsl_multifit_robust)
+#define ROBUST_MAX_ITER 100
+#define ROBUST_FAIR_TUNE 1.4
 
 class Regression
 {
 public:
     Regression(){}
 
-    static std::pair<double, double> robustLinearOls(const std::vector<double> &xs, const std::vector<double> &ys){
-        const size_t p = 2; /* linear fit */
-        gsl_matrix *X, *cov;
-        gsl_vector *x, *y, *c;
-        size_t n = ys.size();
-        X = gsl_matrix_alloc (n, p);
-        x = gsl_vector_alloc (n);
-        y = gsl_vector_alloc (n);
-
-        c = gsl_vector_alloc (p);
-        cov = gsl_matrix_alloc (p, p);
-
-        for (size_t i = 0; i < n; i++){
-            gsl_vector_set (x, i, xs[i]);
-            gsl_vector_set (y, i, ys[i]);
-            gsl_matrix_set (X, i, 0, 1.0);
-            gsl_matrix_set (X, i, 1, xs[i]);
+    /**
+    least squares line (slope, intercept), (0, 0) with less than 2 points
+    **/
+    static std::pair<double, double> robustLinearOls(Span<const double> xs, Span<const double> ys,
+                                                     PatchScratch & = PatchScratch::local()){
+        assert(xs.size() == ys.size());
+        if(ys.size() < 2){
+            return std::pair<double, double>(0., 0.);
         }
-
-        dofit(gsl_multifit_robust_ols, X, y, c, cov);
-        #define C(i) (gsl_vector_get(c,(i)))
-        std::pair<double, double> coeffs;
-        coeffs.first = C(1);
-        coeffs.second = C(0);
-
-        gsl_matrix_free (X);
-        gsl_vector_free (x);
-        gsl_vector_free (y);
-
-        gsl_vector_free (c);
-        gsl_matrix_free (cov);
-
-        return coeffs;
+        return fitLine(xs.data(), ys.data(), ys.size());
     }
-    static std::pair<double, double> robustLinear(const std::vector<double> &xs, const std::vector<double> &ys){
-        const size_t p = 2; /* linear fit */
-        gsl_matrix *X, *cov;
-        gsl_vector *x, *y, *c;
-        size_t n = ys.size();
-        X = gsl_matrix_alloc (n, p);
-        x = gsl_vector_alloc (n);
-        y = gsl_vector_alloc (n);
-
-        c = gsl_vector_alloc (p);
-        cov = gsl_matrix_alloc (p, p);
-
-        for (size_t i = 0; i < n; i++){
-            gsl_vector_set (x, i, xs[i]);
-            gsl_vector_set (y, i, ys[i]);
-            gsl_matrix_set (X, i, 0, 1.0);
-            gsl_matrix_set (X, i, 1, xs[i]);
-        }
-
-        dofit(gsl_multifit_robust_fair, X, y, c, cov);
-        #define C(i) (gsl_vector_get(c,(i)))
-        std::pair<double, double> coeffs;
-        coeffs.first = C(1);
-        coeffs.second = C(0);
-
-        gsl_matrix_free (X);
-        gsl_vector_free (x);
-        gsl_vector_free (y);
-
-        gsl_vector_free (c);
-        gsl_matrix_free (cov);
-
-        return coeffs;
+    /**
+    robust line (slope, intercept) with the fair weight function, see robustFair
+    **/
+    static std::pair<double, double> robustLinear(Span<const double> xs, Span<const double> ys,
+                                                  PatchScratch &scratch = PatchScratch::local()){
+        return robustFair(xs, ys, scratch);
     }
 
-    static std::pair<double, double> linearRegression(const std::vector<double> &xs, const std::vector<double> &ys){
+    static std::pair<double, double> linearRegression(Span<const double> xs, Span<const double> ys, uint64_t seed,
+                                                      PatchScratch &scratch = PatchScratch::local()){
         std::pair<double, double> coefficients;
         size_t N = ys.size();
         assert(xs.size() == N);
@@ -105,15 +63,15 @@ public:
         if( N < MIN_NB_POINTS ){
             return coefficients;
         }
-        double mean = Statistic::getMean(ys);
-        double sd = Statistic::standardDeviation(ys, mean);
-
+        double mean = Statistic::getMean(ys.data(), N);
+        double sd = Statistic::standardDeviation(ys.data(), N, mean);
 
-        std::vector<double> inXs;
-        std::vector<double> inYs;
+        std::vector<double> &inXs = scratch.inXs;
+        std::vector<double> &inYs = scratch.inYs;
+        inXs.clear();
+        inYs.clear();
 
         double th = mean + 2*sd;
-        double th2 = mean - 2*sd;
         for(size_t i = 0; i < N; i++)
         {
 
@@ -130,164 +88,194 @@ public:
         }
 
 
-        return ransac(inXs, inYs, 2, 100);
+        return ransac(inXs, inYs, 2, 100, seed, scratch);
 
     }
 
-    static struct coefs PurgedlinearRegression(const std::vector<double> &xs, const std::vector<double> &ys,const std::vector<double> &zs, const std::vector<unsigned int> &indP){
+    /**
+    line of the points of a patch without the outliers (radius >= mean + 2sd), shifted by the
+    median orthogonal distance. The indices (from indP) of the points kept are left in scratch.selected.
+    seed is the seed of RANSAC (the id of the patch point gives the same result whatever the threads).
+    xs, ys and indP must not be buffers of scratch other than xs, ys and indices.
+    **/
+    static std::pair<double, double> PurgedlinearRegression(Span<const double> xs, Span<const double> ys,
+                                                            Span<const unsigned int> indP, uint64_t seed,
+                                                            PatchScratch &scratch = PatchScratch::local()){
         std::pair<double, double> coeff;
-        struct coefs c;
+        std::vector<double> &inXs = scratch.inXs;
+        std::vector<double> &inYs = scratch.inYs;
+        std::vector<unsigned int> &indPselect = scratch.selected;
+        inXs.clear();
+        inYs.clear();
+        indPselect.clear();
         unsigned int  N = ys.size();
         assert(xs.size() == N);
         //too little infos
         if( N < MIN_NB_POINTS ){
-            return c;
+            return coeff;
         }
-        double mean = Statistic::getMean(ys);
-        double sd = Statistic::standardDeviation(ys, mean);
-        std::vector<double> inXs;
-        std::vector<double> inYs;
-        std::vector<unsigned int> indPselect;
+        double mean = Statistic::getMean(ys.data(), N);
+        double sd = Statistic::standardDeviation(ys.data(), N, mean);
         //filtre sur la moyenne
         double th = mean + 2*sd;
-        double th2 = mean - 2*sd;
         for(unsigned int  i = 0; i < N; i++)
         {
             if(ys[i] < th)
             {
-                indPselect.push_back(indP.at(i));
+                indPselect.push_back(indP[i]);
                 inXs.push_back(xs[i]);
                 inYs.push_back(ys[i]);
             }
         }
-        //filtre by medianne
-        //std::vector<double> inXs2;
-        //std::vector<double> inYs2;
-        //std::vector<unsigned int> indPselect2;
-        //unsigned int T=inYs.size();
-        //double mediane=Statistic::getMedian(inYs);
-        //for(unsigned int i = 0; i < T; i++)
-        //{
-            //if(inYs[i] < mediane   )
-            //{
-                //indPselect2.push_back(indPselect[i]);
-                //inXs2.push_back(inXs[i]);
-                //inYs2.push_back(inYs[i]);
-            //}
-        //}
 
         if(sd < MAX_SD){
             coeff=rmse(inXs, inYs);
         }else{
-            coeff=ransac(inXs, inYs, 2, 100);
+            coeff=ransac(inXs, inYs, 2, 100, seed, scratch);
         }
         //uncomment to shift line (on y axis) by median orhto distance
-        shiftLineByMedianDistance(inXs,inYs,coeff);
-        c.ind_p=indPselect;
-        c.coefficients=coeff;
+        shiftLineByMedianDistance(inXs,inYs,coeff,scratch.distances);
 
-        return c;
+        return coeff;
     }
 
-    static std::pair<double, double> ransac(const std::vector<double> xs, std::vector<double> ys, double epsilon, int minNbIter){
-        //use pcl instead of mine?
+    /**
+    RANSAC line : samples of 2 points, the line with the most points at a distance (on y) < epsilon,
+    then least squares on its inliers. The samples are drawn from a generator seeded with seed, so the
+    result only depends on the points and the seed. Stops when the probability to have missed the best
+    line is below 1e-4 (at least minNbIter samples) or after RANSAC_MAX_SAMPLES samples.
+    **/
+    static std::pair<double, double> ransac(Span<const double> xs, Span<const double> ys, double epsilon, int minNbIter,
+                                            uint64_t seed, PatchScratch &scratch = PatchScratch::local()){
         std::pair<double, double> coefficients;
-        //struct coefs c;
-    srand (time(NULL));
-    std::pair<double, double> coeffrmse = rmse(xs, ys);
-
-    int numberOfIteration = std::numeric_limits<int>::max();
-    double p = 0.9999;
-    int n = xs.size();
-
-    int nbSamples = 0;
-    int bestNbInliers = 0;
-    while (nbSamples < numberOfIteration)
-    {
-        //random select 2 points
-        int p1 = n*(1.0*rand() / RAND_MAX);
-        int p2 = n*(1.0*rand() / RAND_MAX);
-        if(p1 == p2){
-            continue;
+        std::pair<double, double> coeffrmse = rmse(xs, ys);
+
+        int numberOfIteration = RANSAC_MAX_SAMPLES;
+        double p = 0.9999;
+        size_t n = xs.size();
+        if(n < 2){
+            return coeffrmse;
         }
-        double y1 = ys.at(p1);
-        double y2 = ys.at(p2);
+        uint64_t state = seed;
 
-        double x1 = xs.at(p1);
-        double x2 = xs.at(p2);
+        int nbSamples = 0;
+        size_t bestNbInliers = 0;
+        for (int nbDraws = 0; nbDraws < RANSAC_MAX_SAMPLES && nbSamples < numberOfIteration; nbDraws++)
+        {
+            //random select 2 points
+            size_t p1 = randomIndex(state, n);
+            size_t p2 = randomIndex(state, n);
+            if(p1 == p2){
+                continue;
+            }
+            double y1 = ys[p1];
+            double y2 = ys[p2];
 
-        double a = (y1 - y2)/(x1 - x2);
-        double b = y1 - a*x1;
+            double x1 = xs[p1];
+            double x2 = xs[p2];
 
-        if( std::abs(a - coeffrmse.first) > 0.5 ){
-            continue;
-        }
+            double a = (y1 - y2)/(x1 - x2);
+            double b = y1 - a*x1;
 
-        int nbInliers = 0;
-        //calculate the number of inliers
-        for (unsigned int i = 0; i < xs.size(); i++)
-        {
-            double x = xs.at(i);
-            double y = ys.at(i);
-            if(std::abs(a * x + b - y) < epsilon){
-                nbInliers++;
-                //inliers.push_back(i);
+            if( std::abs(a - coeffrmse.first) > 0.5 ){
+                continue;
             }
-        }
 
-        if(nbInliers > bestNbInliers)
-        {
-            bestNbInliers = nbInliers;
-            coefficients.first = a;
-            coefficients.second = b;
-        }
+            size_t nbInliers = countInliers(xs.data(), ys.data(), n, a, b, epsilon);
+
+            if(nbInliers > bestNbInliers)
+            {
+                bestNbInliers = nbInliers;
+                coefficients.first = a;
+                coefficients.second = b;
+            }
+            nbSamples++;
+            if(bestNbInliers == n){
+                break;
+            }
 
-        double w = 1.0*bestNbInliers/xs.size();
-        numberOfIteration = log10(1 - p)/log10(1 - pow(w, 2));
-        if(numberOfIteration < minNbIter) numberOfIteration = minNbIter;
-        nbSamples++;
-        //qDebug()<<"Nb Iter: "<< nbSamples;
-        //qDebug()<<"Nb Iterxxx: "<< numberOfIteration;
-        //qDebug()<<"Max Nb Inliers /n : "<< bestNbInliers << "/"<<n;
+            //number of samples to draw 2 inliers with probability p
+            double w = 1.0*bestNbInliers/n;
+            double nbRequired = log10(1 - p)/log10(1 - pow(w, 2));
+            numberOfIteration = nbRequired < RANSAC_MAX_SAMPLES ? (int) nbRequired : RANSAC_MAX_SAMPLES;
+            if(numberOfIteration < minNbIter) numberOfIteration = minNbIter;
+        }
 
-    }
+        //no acceptable sample
+        if(bestNbInliers == 0){
+            return coeffrmse;
+        }
 
-    //get inliers
-    std::vector<double> inXs;
-    std::vector<double> inYs;
-    for (unsigned int i = 0; i < xs.size(); i++)
-    {
-            double x = xs.at(i);
-            double y = ys.at(i);
+        //get inliers
+        std::vector<double> &inXs = scratch.ransacXs;
+        std::vector<double> &inYs = scratch.ransacYs;
+        inXs.clear();
+        inYs.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            double x = xs[i];
+            double y = ys[i];
             if(std::abs(coefficients.first * x + coefficients.second - y) < epsilon){
                 inXs.push_back(x);
                 inYs.push_back(y);
             }
-    }
-
-    return rmse(inXs, inYs);
+        }
 
+        return rmse(inXs, inYs);
+    }
+    static std::pair<double, double>  rmse(Span<const double> xs, Span<const double> ys){
+        assert(xs.size() == ys.size());
+        return fitLine(xs.data(), ys.data(), xs.size());
     }
-    static std::pair<double, double>  rmse(const std::vector<double> &xs, const std::vector<double> &ys){
-        //struct coefs c;
-        std::pair<double, double> coefficients;
-        size_t N = xs.size();
-
-        //least square fitting with inliers
-        Eigen::MatrixX2d A(N,2);
-        Eigen::VectorXd R(N);
-
-        for (size_t i = 0; i < N; i++){
-            double x = xs.at(i);
-            double y = ys.at(i);
-            A(i, 0) = x;
-            A(i, 1) = 1;
-            R[i] = y;
-        }
 
-        Eigen::Vector2d P = A.colPivHouseholderQr().solve(R);
-        coefficients.first = P[0];
-        coefficients.second = P[1];
+    /**
+    least square line y = first * x + second of n points, closed form of the 2x2 normal equations.
+    Single pass, no allocation. The sums are taken relative to the first point (mean-centered
+    up to a constant) to avoid cancellation, two points per instruction with SSE2.
+    Return (0, 0) without points and a horizontal line through the mean if all x are equal.
+    **/
+    static std::pair<double, double> fitLine(const double *xs, const double *ys, size_t n){
+        std::pair<double, double> coefficients(0., 0.);
+        if(n == 0){
+            return coefficients;
+        }
+        double x0 = xs[0];
+        double y0 = ys[0];
+        double sdx = 0., sdy = 0., sdxx = 0., sdxy = 0.;
+        size_t i = 0;
+#ifdef __SSE2__
+        __m128d vx0 = _mm_set1_pd(x0), vy0 = _mm_set1_pd(y0);
+        __m128d vsdx = _mm_setzero_pd(), vsdy = _mm_setzero_pd();
+        __m128d vsdxx = _mm_setzero_pd(), vsdxy = _mm_setzero_pd();
+        for(; i + 2 <= n; i += 2){
+            __m128d dx = _mm_sub_pd(_mm_loadu_pd(xs + i), vx0);
+            __m128d dy = _mm_sub_pd(_mm_loadu_pd(ys + i), vy0);
+            vsdx = _mm_add_pd(vsdx, dx);
+            vsdy = _mm_add_pd(vsdy, dy);
+            vsdxx = _mm_add_pd(vsdxx, _mm_mul_pd(dx, dx));
+            vsdxy = _mm_add_pd(vsdxy, _mm_mul_pd(dx, dy));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, vsdx); sdx = lanes[0] + lanes[1];
+        _mm_storeu_pd(lanes, vsdy); sdy = lanes[0] + lanes[1];
+        _mm_storeu_pd(lanes, vsdxx); sdxx = lanes[0] + lanes[1];
+        _mm_storeu_pd(lanes, vsdxy); sdxy = lanes[0] + lanes[1];
+#endif
+        for(; i < n; i++){
+            double dx = xs[i] - x0;
+            double dy = ys[i] - y0;
+            sdx += dx;
+            sdy += dy;
+            sdxx += dx * dx;
+            sdxy += dx * dy;
+        }
+        double mdx = sdx / n;
+        double mdy = sdy / n;
+        double cxx = sdxx - n * mdx * mdx;
+        double cxy = sdxy - n * mdx * mdy;
+        double a = cxx > 0 ? cxy / cxx : 0.;
+        coefficients.first = a;
+        coefficients.second = (y0 + mdy) - a * (x0 + mdx);
         return coefficients;
     }
 private:
@@ -327,47 +315,172 @@ private:
     }
 
     /**
-    shift line by distances between the farest point to the fitted line and fitted line
+    shift line by the median orthogonal distance of the points to the fitted line,
+    distanceToLine is a buffer for the distances
     **/
     static void
-    shiftLineByMedianDistance(std::vector<double> xs,std::vector<double> ys, std::pair<double, double> &coefs){
+    shiftLineByMedianDistance(Span<const double> xs, Span<const double> ys, std::pair<double, double> &coefs,
+                              std::vector<double> &distanceToLine){
         assert(xs.size()==ys.size());
-        std::vector<double> distanceToLine;
+        distanceToLine.clear();
         double currentRadius;
         double currentHeight;
-        double maxdistance;
         double A,B,C;
         double distanceLine;
-        //reinit of maxdistance
-        maxdistance=INT_MIN;
         //fitted line in cartesian form
         A=coefs.first;
         B=-1;
         C=coefs.second;
+        double norm = sqrt((A*A)+(B*B));
         //loop on points in patch
         for (unsigned int i = 0; i < xs.size (); ++i){
-            currentHeight=xs.at(i);
-            currentRadius=ys.at(i);
+            currentHeight=xs[i];
+            currentRadius=ys[i];
             //perpendicular distance
-            distanceLine=abs((A*currentHeight)+(B*currentRadius)+C)/sqrt((A*A)+(B*B));
+            distanceLine=std::abs((A*currentHeight)+(B*currentRadius)+C)/norm;
             distanceToLine.push_back(distanceLine);
         }
-        double median = Statistic::getMedian(distanceToLine);
+        double median = Statistic::getMedianInPlace(distanceToLine.data(), distanceToLine.data() + distanceToLine.size());
         coefs.second-=median;
     }
 
-    static int
-    dofit(const gsl_multifit_robust_type *T,
-          const gsl_matrix *X, const gsl_vector *y,
-          gsl_vector *c, gsl_matrix *cov){
-        int s;
-        gsl_multifit_robust_workspace * work
-            = gsl_multifit_robust_alloc (T, X->size1, X->size2);
-        //gsl_multifit_robust_maxiter(100000, work);
-        //gsl_multifit_robust_tune(4, work);
-        s = gsl_multifit_robust (X, y, c, cov, work);
-        gsl_multifit_robust_free (work);
-        return s;
+    /**
+    next value of a splitmix64 generator
+    **/
+    static uint64_t
+    nextRandom(uint64_t &state){
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    /**
+    uniform index in [0, n)
+    **/
+    static size_t
+    randomIndex(uint64_t &state, size_t n){
+        return (size_t) (((nextRandom(state) >> 32) * (uint64_t) n) >> 32);
+    }
+
+    /**
+    number of points with |a * x + b - y| < epsilon, two points per instruction with SSE2
+    **/
+    static size_t
+    countInliers(const double *xs, const double *ys, size_t n, double a, double b, double epsilon){
+        size_t nbInliers = 0;
+        size_t i = 0;
+#ifdef __SSE2__
+        __m128d va = _mm_set1_pd(a), vb = _mm_set1_pd(b), veps = _mm_set1_pd(epsilon);
+        __m128d signMask = _mm_set1_pd(-0.0);
+        //the comparison mask is -1 per lane for an inlier
+        __m128i vcount = _mm_setzero_si128();
+        for(; i + 2 <= n; i += 2){
+            __m128d r = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(va, _mm_loadu_pd(xs + i)), vb), _mm_loadu_pd(ys + i));
+            __m128d inlier = _mm_cmplt_pd(_mm_andnot_pd(signMask, r), veps);
+            vcount = _mm_sub_epi64(vcount, _mm_castpd_si128(inlier));
+        }
+        long long lanes[2];
+        _mm_storeu_si128((__m128i *) lanes, vcount);
+        nbInliers = lanes[0] + lanes[1];
+#endif
+        for(; i < n; i++){
+            nbInliers += std::abs(a * xs[i] + b - ys[i]) < epsilon;
+        }
+        return nbInliers;
+    }
+
+    /**
+    robust line with the fair weight function w(u) = 1 / (1 + |u|), by iteratively reweighted least
+    squares as gsl_multifit_robust : start from least squares, adjust the residuals by the leverage
+    1 / sqrt(1 - h), scale them by the MAD estimate of sigma and the tuning constant, refit with the
+    weights until the coefficients are stable. Works in the weights, residuals and leverages buffers
+    of scratch, which only grow : once they reach the size of the largest patch a fit allocates nothing.
+    Checked against GSL by robustCheck.
+    **/
+    static std::pair<double, double>
+    robustFair(Span<const double> xs, Span<const double> ys, PatchScratch &scratch){
+        size_t n = ys.size();
+        assert(xs.size() == n);
+        std::pair<double, double> coeffs(0., 0.);
+        if(n < 2){
+            return coeffs;
+        }
+        if(scratch.weights.size() < n){
+            scratch.weights.resize(n);
+            scratch.residuals.resize(n);
+            scratch.leverages.resize(n);
+        }
+        double *w = scratch.weights.data();
+        double *r = scratch.residuals.data();
+        double *resfac = scratch.leverages.data();
+        //leverage of each point in the least squares fit : h = 1/n + (x - mean)^2 / Sxx
+        double mx = Statistic::getMean(xs.data(), n);
+        double sxx = 0.;
+        for(size_t i = 0; i < n; i++){
+            sxx += (xs[i] - mx) * (xs[i] - mx);
+        }
+        for(size_t i = 0; i < n; i++){
+            double h = 1.0 / n + (sxx > 0 ? (xs[i] - mx) * (xs[i] - mx) / sxx : 0.);
+            resfac[i] = 1.0 / sqrt(1.0 - std::min(h, 0.9999));
+        }
+        coeffs = fitLine(xs.data(), ys.data(), n);
+        const double tol = sqrt(std::numeric_limits<double>::epsilon());
+        for(int iter = 0; iter < ROBUST_MAX_ITER; iter++){
+            //residuals adjusted by the leverage, sigma is estimated on them as GSL does
+            for(size_t i = 0; i < n; i++){
+                r[i] = (ys[i] - (coeffs.first * xs[i] + coeffs.second)) * resfac[i];
+                w[i] = std::abs(r[i]);
+            }
+            double sigma = madSigma(w, n);
+            //more than half of the points exactly on the line : keep it. Deliberate difference with
+            //GSL, which scales the residuals by 1 / sigma without testing it
+            if(sigma == 0.){
+                break;
+            }
+            for(size_t i = 0; i < n; i++){
+                double u = r[i] / (ROBUST_FAIR_TUNE * sigma);
+                w[i] = 1.0 / (1.0 + std::abs(u));
+            }
+            std::pair<double, double> previous = coeffs;
+            coeffs = fitWeightedLine(xs.data(), ys.data(), w, n);
+            if(std::abs(coeffs.first - previous.first) <= tol * std::max(std::abs(coeffs.first), std::abs(previous.first)) &&
+               std::abs(coeffs.second - previous.second) <= tol * std::max(std::abs(coeffs.second), std::abs(previous.second))){
+                break;
+            }
+        }
+        return coeffs;
+    }
+
+    /**
+    robust estimate of sigma from the absolute residuals (n >= 2, reordered) : median of all but the
+    smallest one (p - 1 for p = 2 parameters, as GSL) / 0.6745
+    **/
+    static double madSigma(double *absResiduals, size_t n){
+        std::iter_swap(absResiduals, std::min_element(absResiduals, absResiduals + n));
+        return Statistic::getMedianInPlace(absResiduals + 1, absResiduals + n) / 0.6745;
+    }
+
+    /**
+    weighted least squares line, sums centered on the weighted means
+    **/
+    static std::pair<double, double> fitWeightedLine(const double *xs, const double *ys, const double *w, size_t n){
+        double sw = 0., swx = 0., swy = 0.;
+        for(size_t i = 0; i < n; i++){
+            sw += w[i];
+            swx += w[i] * xs[i];
+            swy += w[i] * ys[i];
+        }
+        double mx = swx / sw;
+        double my = swy / sw;
+        double cxx = 0., cxy = 0.;
+        for(size_t i = 0; i < n; i++){
+            double dx = xs[i] - mx;
+            cxx += w[i] * dx * dx;
+            cxy += w[i] * dx * (ys[i] - my);
+        }
+        double a = cxx > 0 ? cxy / cxx : 0.;
+        return std::pair<double, double>(a, my - a * mx);
     }
 
 };
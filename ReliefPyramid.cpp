@@ -0,0 +1,56 @@
+#include <algorithm>
+
+#include "ReliefPyramid.h"
+#include "MultiThreadHelper.h"
+
+//rows of a level per chunk
+#define PYRAMID_ROW_GRAIN 16
+
+void
+ReliefPyramid::build(const CsrIndex &cells, int height, int width, const std::vector<double> &relief, int nbLevels){
+    ThreadPool &pool = ThreadPool::getInstance();
+    levels.assign(std::max(1, nbLevels), Level());
+
+    //level 0 : one value per cell
+    Level &base = levels[0];
+    base.height = height;
+    base.width = width;
+    base.maxs.assign((size_t) height * width, INT_MIN);
+    base.sums.assign((size_t) height * width, 0.);
+    base.counts.assign((size_t) height * width, 0);
+    pool.parallelFor(0, height, PYRAMID_ROW_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t c = lo * width; c < hi * width; c++){
+            for(unsigned int indP : cells.cell(c)){
+                base.maxs[c] = std::max(base.maxs[c], relief[indP]);
+                base.sums[c] += relief[indP];
+            }
+            base.counts[c] = cells.cellSize(c);
+        }
+    });
+
+    //level k : reduction of the 2 x 2 blocks of level k-1
+    for(size_t k = 1; k < levels.size(); k++){
+        const Level &fine = levels[k - 1];
+        Level &coarse = levels[k];
+        coarse.height = (fine.height + 1) / 2;
+        coarse.width = (fine.width + 1) / 2;
+        coarse.maxs.assign((size_t) coarse.height * coarse.width, INT_MIN);
+        coarse.sums.assign((size_t) coarse.height * coarse.width, 0.);
+        coarse.counts.assign((size_t) coarse.height * coarse.width, 0);
+        pool.parallelFor(0, coarse.height, PYRAMID_ROW_GRAIN, [&](size_t, size_t lo, size_t hi){
+            for(size_t i = lo; i < hi; i++){
+                for(int j = 0; j < coarse.width; j++){
+                    size_t c = i * coarse.width + j;
+                    for(size_t fi = 2*i; fi < std::min<size_t>(2*i + 2, fine.height); fi++){
+                        for(size_t fj = 2*j; fj < std::min<size_t>(2*j + 2, fine.width); fj++){
+                            size_t f = fi * fine.width + fj;
+                            coarse.maxs[c] = std::max(coarse.maxs[c], fine.maxs[f]);
+                            coarse.sums[c] += fine.sums[f];
+                            coarse.counts[c] += fine.counts[f];
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef RELIEF_PYRAMID_H
+#define RELIEF_PYRAMID_H
+
+#include <vector>
+#include <climits>
+
+#include "CsrIndex.h"
+#include "ReliefReducer.h"
+
+/**
+ * Aggregates (max, sum, count) of the relief of the cells of the unrolled surface, at the full
+ * resolution (level 0) and reduced by 2 x 2 blocks for each next level. Cell (i, j) of level k
+ * covers the cells [i*2^k, (i+1)*2^k[ x [j*2^k, (j+1)*2^k[ of level 0 (clipped to the surface),
+ * the same blocks as UnrolledMap::getIndPointsInLowerResolution, so a lookup at any resolution is O(1).
+ **/
+class ReliefPyramid{
+    public:
+        ReliefPyramid(){}
+
+        /**
+        build nbLevels levels (at least 1) from the cells of a height x width surface in CSR
+        (cell (i,j) is i*width+j) and the relief of each point
+        **/
+        void build(const CsrIndex &cells, int height, int width, const std::vector<double> &relief, int nbLevels);
+
+        int getNbLevels() const {
+            return levels.size();
+        }
+
+        /**
+        max relief of the block of (i,j) at level, -1 if the block is empty
+        (as MaxReducer on the points of the block, starting from INT_MIN)
+        **/
+        double getMax(int level, unsigned int i, unsigned int j) const {
+            const Level &l = levels[level];
+            size_t c = (size_t) (i >> level) * l.width + (j >> level);
+            return l.counts[c] == 0 ? -1 : l.maxs[c];
+        }
+
+        /**
+        sum of the relief of the block of (i,j) at level, -1 if the block is empty
+        **/
+        double getSum(int level, unsigned int i, unsigned int j) const {
+            const Level &l = levels[level];
+            size_t c = (size_t) (i >> level) * l.width + (j >> level);
+            return l.counts[c] == 0 ? -1 : l.sums[c];
+        }
+
+        /**
+        mean relief of the block of (i,j) at level, -1 if the block is empty
+        **/
+        double getMean(int level, unsigned int i, unsigned int j) const {
+            const Level &l = levels[level];
+            size_t c = (size_t) (i >> level) * l.width + (j >> level);
+            return l.counts[c] == 0 ? -1 : l.sums[c] / l.counts[c];
+        }
+
+        /**
+        max, sum and count of the block of (i,j) at level, without the values
+        **/
+        CellStats getStats(int level, unsigned int i, unsigned int j) const {
+            const Level &l = levels[level];
+            size_t c = (size_t) (i >> level) * l.width + (j >> level);
+            CellStats stats = {l.maxs[c], l.sums[c], l.counts[c], nullptr};
+            return stats;
+        }
+
+        unsigned int getCount(int level, unsigned int i, unsigned int j) const {
+            const Level &l = levels[level];
+            return l.counts[(size_t) (i >> level) * l.width + (j >> level)];
+        }
+
+    protected:
+        struct Level{
+            int height = 0;
+            int width = 0;
+            std::vector<double> maxs;
+            std::vector<double> sums;
+            std::vector<unsigned int> counts;
+        };
+
+        std::vector<Level> levels;
+};
+
+#endif // RELIEF_PYRAMID_H
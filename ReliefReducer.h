@@ -0,0 +1,123 @@
+#ifndef RELIEF_REDUCER_H
+#define RELIEF_REDUCER_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+#include "Statistic.h"
+
+/**
+ * Aggregates of the relief of the points of a cell (or of a block of cells).
+ * values (relief of each point) is only filled when a reducer needs it, the
+ * selection based reducers reorder it.
+ **/
+struct CellStats{
+    double max;
+    double sum;
+    unsigned int count;
+    double *values;
+};
+
+/**
+ * Reduction policies of a cell : reduce(stats) is the value of a non empty cell,
+ * needValues tells if stats.values must be filled.
+ **/
+struct MaxReducer{
+    static const bool needValues = false;
+    static double reduce(const CellStats &stats){
+        return stats.max;
+    }
+};
+
+struct SumReducer{
+    static const bool needValues = false;
+    static double reduce(const CellStats &stats){
+        return stats.sum;
+    }
+};
+
+struct MeanReducer{
+    static const bool needValues = false;
+    static double reduce(const CellStats &stats){
+        return stats.sum / stats.count;
+    }
+};
+
+struct CountReducer{
+    static const bool needValues = false;
+    static double reduce(const CellStats &stats){
+        return stats.count;
+    }
+};
+
+struct MedianReducer{
+    static const bool needValues = true;
+    static double reduce(const CellStats &stats){
+        return Statistic::getMedianInPlace(stats.values, stats.values + stats.count);
+    }
+};
+
+/**
+ * P-th percentile (nearest rank on [0, count-1]) by selection
+ **/
+template<int P>
+struct PercentileReducer{
+    static const bool needValues = true;
+    static double reduce(const CellStats &stats){
+        double *kth = stats.values + (size_t) std::round(P / 100.0 * (stats.count - 1));
+        std::nth_element(stats.values, kth, stats.values + stats.count);
+        return *kth;
+    }
+};
+
+
+constexpr bool anyNeedValues(){
+    return false;
+}
+
+template<typename... Bools>
+constexpr bool anyNeedValues(bool first, Bools... others){
+    return first || anyNeedValues(others...);
+}
+
+/**
+ * Several reductions of the same cell in one sweep : out[k] is the value of the k-th reducer,
+ * -1 for an empty cell (as the former UnrolledMap::*ReliefRepresentation).
+ **/
+template<typename... Reducers>
+struct CellReducer{
+    static const bool needValues = anyNeedValues(Reducers::needValues...);
+    static const int size = sizeof...(Reducers);
+
+    static void reduce(const CellStats &stats, double *out){
+        if(stats.count == 0){
+            std::fill(out, out + size, -1.);
+            return;
+        }
+        int k = 0;
+        //braced list : the reducers run in order
+        int expand[] = {0, (out[k++] = Reducers::reduce(stats), 0)...};
+        (void) expand;
+    }
+};
+
+/**
+ * reduction of the relief image of segunroll (option --reliefReducer)
+ **/
+enum ReliefReduction{MAX_RELIEF, MEAN_RELIEF, SUM_RELIEF, MEDIAN_RELIEF, COUNT_RELIEF, P10_RELIEF, P90_RELIEF};
+
+inline bool
+parseReliefReduction(const std::string &name, ReliefReduction &reduction){
+    static const char *names[] = {"max", "mean", "sum", "median", "count", "p10", "p90"};
+    for(int k = 0; k <= P90_RELIEF; k++){
+        if(name == names[k]){
+            reduction = (ReliefReduction) k;
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // RELIEF_REDUCER_H
@@ -3,6 +3,9 @@
 #include <utility>
 #include <cmath>
 #include <thread>
+#include <numeric>
+#include <algorithm>
+#include <cstdint>
 //debug
 #include <stdlib.h>
 #include <time.h>
@@ -22,6 +25,12 @@
 #include "Statistic.h"
 #include "IOHelper.h"
 #include "MultiThreadHelper.h"
+#include "FastMath.h"
+#include "ThresholdEngine.h"
+#include "TileThreshold.h"
+
+//minimum number of points used to estimate the mean radius of a segment
+#define SEGMENT_RADIUS_MIN_POINTS 1000
 
 
 
@@ -57,7 +66,11 @@ SegmentationAbstract::init(){
     computeBeginOfSegment();
     computeVectorMarks();
     computePlaneNormals();
+    computeSegmentFrames();
 	convertToCcs();
+    if(spatialReorder){
+        reorderPoints();
+    }
 //    computeAngleOfPoints();
 //    computeCells();
     computeEquations();
@@ -80,116 +93,76 @@ SegmentationAbstract::allocate(){
     segmentLength.resize(nbSegment);
     vectMarks.resize(nbSegment);
     ns.resize(nbSegment);
+    segmentFrames.resize(nbSegment);
 }
 
 
 double SegmentationAbstract::findThresholdRosin(){
-    //build histogram
-    double res = binWidth; //must be configurable?
-//trace.error()<<"binWidth:"<<binWidth<<std::endl;
-    double maxValue = *std::max_element(distances.begin(), distances.end());
-    double minValue = *std::min_element(distances.begin(), distances.end());
-    double range = maxValue - minValue;
-    int nbInterval = range / res;
-
-    std::vector<int> histogram(nbInterval, 0);
-    for(unsigned int i = 0; i < myPoints.size(); i++){
-        int index = (distances.at(i) - minValue)/res;
-        histogram[index]++;
-    }
-    std::vector<int>::iterator maxFreq = std::max_element(histogram.begin(), histogram.end());
-
-    int maxFreqValue = *maxFreq;
-    int maxFreqIndex = std::distance(histogram.begin(), maxFreq);
-    assert(maxFreqValue == histogram.at(maxFreqIndex));
-
-    unsigned int lastIndex = histogram.size() - 1;
-    int lastValue = histogram.at(lastIndex);
+    return findThreshold(ROSIN_THRESHOLD);
+}
 
+double SegmentationAbstract::findThreshold(ThresholdMethod method){
+    //histogram of the distances, bins of binWidth
+    ThresholdEngine engine(binWidth);
+    engine.setDump(thresholdDump);
+    engine.build(distances);
+    return engine.getThreshold(method);
+}
 
-    for(unsigned int i = maxFreqIndex; i < histogram.size(); i++){
-        if(histogram.at(i) == 0){
-            lastIndex = i;
-            lastValue = 0;
-            break;
+/**
+ * indices (in the original point cloud, sorted) of the points i with isDefect(i)
+ */
+template<typename F>
+std::vector<unsigned int>
+SegmentationAbstract::compactDefects(const F &isDefect){
+    ThreadPool &pool = ThreadPool::getInstance();
+    size_t nbPoints = myPoints.size();
+    //first pass : count the defects of each chunk
+    std::vector<unsigned int> offsets(ThreadPool::getNbChunks(0, nbPoints, PARALLEL_GRAIN) + 1, 0);
+    pool.parallelFor(0, nbPoints, PARALLEL_GRAIN, [&](size_t c, size_t chunkBegin, size_t chunkEnd){
+        unsigned int nb = 0;
+        for(size_t i = chunkBegin; i < chunkEnd; i++){
+            nb += isDefect(i);
         }
-    }
-
-    double valueDiff = lastValue - maxFreqValue;
-    double valueDiff2 = valueDiff *valueDiff;
-    double indexDiff = lastIndex - maxFreqIndex;
-    double indexDiff2 = indexDiff * indexDiff;
-    double bestThresIndex = maxFreqIndex;
-    double bestDist = 0;
-
-    //line between maxFreq and last element of historgram
-    double a = (lastValue - maxFreqValue)*1.0/(lastIndex - maxFreqIndex);
-    double b = maxFreqValue - a * maxFreqIndex;
-
-    //for (std::vector<int>::iterator it = maxFreq ; it != histogram.end(); ++it){
-    for (unsigned int i = maxFreqIndex; i < lastIndex; i++){
-        //trace.info()<<valueDiff *  i - indexDiff*histogram.at(i) + maxFreqIndex*lastValue - maxFreqValue * lastIndex<<std::endl;
-        double dist = std::abs(valueDiff *  i - indexDiff*histogram.at(i) + maxFreqValue*lastIndex - maxFreqIndex * lastValue)/
-            sqrt(valueDiff2 + indexDiff2 );
-        if(dist > bestDist){
-            bestDist = dist;
-            bestThresIndex = i;
-            //trace.info()<<"dist:"<<bestDist<< std::endl;
-            //trace.info()<<"bestThresIndex:"<<bestThresIndex<< std::endl;
+        offsets[c + 1] = nb;
+    });
+    //prefix sum gives where each chunk writes
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    //second pass : scatter, the defects stay sorted by index
+    std::vector<unsigned int> defects(offsets.back());
+    pool.parallelFor(0, nbPoints, PARALLEL_GRAIN, [&](size_t c, size_t chunkBegin, size_t chunkEnd){
+        unsigned int pos = offsets[c];
+        for(size_t i = chunkBegin; i < chunkEnd; i++){
+            if(isDefect(i)){
+                defects[pos++] = getOriginalIndex(i);
+            }
         }
+    });
+    if(!originalIds.empty()){
+        std::sort(defects.begin(), defects.end());
     }
-
-    /**
-     * perpendicular line: -1/a + c passe through bestThresIndex
-     * -1/ax1 + c = y1
-     *  c = y1 + 1/ax1
-     *  ax2 + b = y2
-     * -1/ax2 + c = y2
-     *  -1/ax2 + y1 + 1/ax1 = y2
-     *  (a + 1/a)x2 = y1 + 1/ax1 -b
-     */
-    int bestVal = histogram.at(bestThresIndex);
-    double x2 = (bestVal + bestThresIndex/a - b)/(a + 1/a);
-    double y2 = b + a*x2;
-
-    std::vector<std::pair<double, double>> forPlot;
-    std::pair<double, double> maxPoint(maxFreqIndex * res + minValue, maxFreqValue);
-    std::pair<double, double> lastPoint(lastIndex * res + minValue, lastValue);
-    std::pair<double, double> bestPoint(bestThresIndex * res + minValue, bestVal);
-    std::pair<double, double> projBestPoint(x2* res + minValue, y2);
-
-    forPlot.push_back(maxPoint);
-    forPlot.push_back(lastPoint);
-    forPlot.push_back(bestPoint);
-    forPlot.push_back(projBestPoint);
-    IOHelper::export2Text(forPlot, "pointFile");
-
-    //histogram
-    std::vector<std::pair<double, double>> histForPlot;
-    for(unsigned int i = 0; i< histogram.size(); i++){
-        std::pair<double, double> aBin(i* res + minValue, histogram.at(i));
-        histForPlot.push_back(aBin);
-    }
-
-    IOHelper::export2Text(histForPlot, "hist2d");
-	trace.info()<<"threshold: "<< bestThresIndex*res + minValue<<std::endl;
-    return bestThresIndex*res + minValue;
+    return defects;
 }
 
 std::vector<unsigned int>
 SegmentationAbstract::getDefect(double threshold){
-    std::vector<unsigned int> defects;
-    for(unsigned int i = 0; i < myPoints.size(); i++){
-        if(distances[i] > threshold){
-            defects.push_back(i);
-        }
-    }
-    return defects;
+    return compactDefects([&](size_t i){ return distances[i] > threshold; });
+}
+
+std::vector<unsigned int>
+SegmentationAbstract::getDefect(const std::vector<double> &thresholds){
+    return compactDefects([&](size_t i){ return distances[i] > thresholds[i]; });
 }
 
 std::vector<unsigned int>
 SegmentationAbstract::getDefect(){
-    double th = findThresholdRosin();
+    if(tileThresholdSize > 0){
+        std::vector<double> thresholds;
+        TileThreshold tileThreshold(tileThresholdSize, binWidth, thresholdMethod);
+        tileThreshold.compute(myPoints, distances, radii, thresholds);
+        return getDefect(thresholds);
+    }
+    double th = findThreshold(thresholdMethod);
     return getDefect(th);
 }
 
@@ -225,43 +198,62 @@ SegmentationAbstract::getRadialVector(const Z3i::RealPoint &aPoint, const Z3i::R
 
 
 void SegmentationAbstract::convertToCcs(){
-    double sumRadii = 0.0;
-    for(unsigned int i = 0; i < pointCloud.size(); i++){
-        Z3i::RealPoint aPoint = pointCloud.at(i);
-        unsigned int segmentId = getSegment(aPoint);
-
-        myPoints[i].segmentId = segmentId;
-        assert(segmentId < fiber.size() - 1);
-
-        Z3i::RealPoint aDir = fiber[segmentId + 1] - fiber[segmentId];
-        aDir = aDir / aDir.norm();
-        Z3i::RealPoint vectRadial = getRadialVector(pointCloud[i], aDir, fiber[segmentId]);
-        double ra = vectRadial.norm();
-        sumRadii += ra;
-        //radius of point
-        myPoints[i].radius = ra;
-
-        Z3i::RealPoint p0 = fiber[segmentId];
-        Z3i::RealPoint vectDir = getDirectionVector(segmentId);
-        Z3i::RealPoint vect = aPoint - p0;
-        double dist = vect.dot(vectDir);
-        //z
-        myPoints[i].height = beginOfSegment[segmentId] + dist;
-
-
-        double angle = acos(vectRadial.dot(vectMarks[segmentId])/
-                vectMarks[segmentId].norm()/vectRadial.norm());
-        //Z3i::RealPoint crossProduct = vectMarks[segmentId].crossProduct(vectRadial);
-        Z3i::RealPoint u = vectMarks[segmentId].crossProduct(vectDir);
-        if (u.dot(vectRadial) < 0)
-        {
-            angle = 2 * M_PI - angle;
+    double sumRadii = ThreadPool::getInstance().parallelReduce(0, pointCloud.size(), PARALLEL_GRAIN, 0.0,
+            [this](size_t chunkBegin, size_t chunkEnd){
+        double chunkSumRadii = 0.0;
+        //coordinates in the local frames are buffered by block to compute angles in batch
+        const unsigned int blockSize = 256;
+        double xs[blockSize], ys[blockSize], angles[blockSize];
+        for(size_t blockBegin = chunkBegin; blockBegin < chunkEnd; blockBegin += blockSize){
+            size_t blockEnd = std::min<size_t>(blockBegin + blockSize, chunkEnd);
+            for(size_t i = blockBegin; i < blockEnd; i++){
+                const Z3i::RealPoint &aPoint = pointCloud[i];
+                unsigned int segmentId = getSegment(aPoint);
+
+                myPoints[i].segmentId = segmentId;
+                assert(segmentId < fiber.size() - 1);
+
+                const SegmentFrame &frame = segmentFrames[segmentId];
+                Z3i::RealPoint vect = aPoint - frame.origin;
+                //coordinates of the point in the local frame of its segment
+                double dist = vect.dot(frame.axis);
+                double x = vect.dot(frame.mark);
+                double y = vect.dot(frame.binormal);
+                //the radial vector lies in the plane (mark, binormal)
+                double ra = sqrt(x*x + y*y);
+                chunkSumRadii += ra;
+                //radius of point
+                myPoints[i].radius = ra;
+                //z
+                myPoints[i].height = frame.begin + dist;
+
+                xs[i - blockBegin] = x;
+                ys[i - blockBegin] = y;
+            }
+            //angle in [0, 2pi[ from the mark, positive toward the binormal
+            FastMath::angle2Pi(ys, xs, angles, blockEnd - blockBegin);
+            for(size_t i = blockBegin; i < blockEnd; i++){
+                myPoints[i].angle = angles[i - blockBegin];
+            }
         }
-        //angle
-        myPoints[i].angle = angle;
+        return chunkSumRadii;
+    });
+    radii = sumRadii / pointCloud.size();
+}
+
 
+void
+SegmentationAbstract::computeSegmentFrames(){
+    for (int i = 0; i < nbSegment; i++){
+        SegmentFrame &frame = segmentFrames[i];
+        frame.origin = fiber[i];
+        frame.axis = getDirectionVector(i);
+        //vectMarks are built orthogonal to the segment, project anyway to keep the frame orthonormal
+        Z3i::RealPoint m = vectMarks[i] - vectMarks[i].dot(frame.axis)*frame.axis;
+        frame.mark = m.getNormalized();
+        frame.binormal = frame.mark.crossProduct(frame.axis).getNormalized();
+        frame.begin = beginOfSegment[i];
     }
-    radii = sumRadii / pointCloud.size();
 }
 
 
@@ -319,9 +311,162 @@ SegmentationAbstract::computeVectorMarks(){
 }
 
 
+void
+SegmentationAbstract::reportBusyTimes(const std::vector<double> &busyTimes){
+    double sum = std::accumulate(busyTimes.begin(), busyTimes.end(), 0.0);
+    double maxTime = *std::max_element(busyTimes.begin(), busyTimes.end());
+    for(unsigned int i = 0; i < busyTimes.size(); i++){
+        trace.info()<<"worker "<<i<<" busy : "<<busyTimes[i]<<" ms"<<std::endl;
+    }
+    trace.info()<<"busy time : total "<<sum<<" ms, max/mean "<<(sum > 0 ? maxTime * busyTimes.size() / sum : 1.0)<<std::endl;
+}
+
 std::vector<double>
 SegmentationAbstract::getDistances(){
-    return distances;
+    if(originalIds.empty()){
+        return distances;
+    }
+    std::vector<double> originalDistances(distances.size());
+    for(unsigned int i = 0; i < distances.size(); i++){
+        originalDistances[originalIds[i]] = distances[i];
+    }
+    return originalDistances;
+}
+
+void
+SegmentationAbstract::setSpatialReorder(bool reorder){
+    spatialReorder = reorder;
+}
+
+void
+SegmentationAbstract::setThresholdMethod(ThresholdMethod method){
+    thresholdMethod = method;
+}
+
+void
+SegmentationAbstract::setTileThreshold(double tileSize){
+    tileThresholdSize = tileSize;
+}
+
+void
+SegmentationAbstract::setThresholdDump(bool dump){
+    thresholdDump = dump;
+}
+
+void
+SegmentationAbstract::setAdaptivePatch(bool adaptive){
+    adaptivePatch = adaptive;
+}
+
+void
+SegmentationAbstract::setMaxPatchPoints(unsigned int maxPoints){
+    maxPatchPoints = maxPoints;
+}
+
+void
+SegmentationAbstract::computeSegmentPatchAngles(){
+    segmentPatchAngles.assign(nbSegment, arcLength / radii);
+    if(!adaptivePatch || nbSegment == 0){
+        return;
+    }
+    std::vector<double> sumRadii(nbSegment, 0.);
+    std::vector<unsigned int> counts(nbSegment, 0);
+    for(unsigned int i = 0; i < myPoints.size(); i++){
+        sumRadii[myPoints[i].segmentId] += myPoints[i].radius;
+        counts[myPoints[i].segmentId]++;
+    }
+    //segments with few points take the neighbour segments too
+    for(int s = 0; s < nbSegment; s++){
+        double sum = sumRadii[s];
+        unsigned int count = counts[s];
+        for(int d = 1; count < SEGMENT_RADIUS_MIN_POINTS && (s - d >= 0 || s + d < nbSegment); d++){
+            if(s - d >= 0){
+                sum += sumRadii[s - d];
+                count += counts[s - d];
+            }
+            if(s + d < nbSegment){
+                sum += sumRadii[s + d];
+                count += counts[s + d];
+            }
+        }
+        if(count > 0 && sum > 0){
+            segmentPatchAngles[s] = arcLength / (sum / count);
+        }
+    }
+    auto minMax = std::minmax_element(segmentPatchAngles.begin(), segmentPatchAngles.end());
+    trace.info()<<"adaptive patch angle : "<<*minMax.first<<" to "<<*minMax.second
+                <<" rad (global "<<arcLength / radii<<")"<<std::endl;
+}
+
+unsigned int
+SegmentationAbstract::getOriginalIndex(unsigned int i){
+    return originalIds.empty() ? i : originalIds[i];
+}
+
+/**
+ * index of (x, y) along the Hilbert curve filling the square [0, 2^order[^2
+ */
+static uint64_t
+hilbertIndex(uint32_t x, uint32_t y, unsigned int order){
+    uint32_t n = 1u << order;
+    uint64_t d = 0;
+    for(uint32_t s = n / 2; s > 0; s /= 2){
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        d += (uint64_t) s * s * ((3 * rx) ^ ry);
+        //rotate the quadrant
+        if(ry == 0){
+            if(rx == 1){
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+void
+SegmentationAbstract::reorderPoints(){
+    trace.info()<<"Reorder points along a Hilbert curve..."<<std::endl;
+    const unsigned int order = 16;
+    size_t nbPoints = myPoints.size();
+    CylindricalPointOrder heightOrder;
+    auto minMaxElem = std::minmax_element(myPoints.begin(), myPoints.end(), heightOrder);
+    double minHeight = (*minMaxElem.first).height;
+    double maxHeight = (*minMaxElem.second).height;
+    //same step along the height and the arc length to keep the cells square
+    double extent = std::max(maxHeight - minHeight, 2 * M_PI * radii);
+    double step = extent > 0 ? extent / ((1u << order) - 1) : 1.0;
+
+    std::vector<std::pair<uint64_t, unsigned int> > keys(nbPoints);
+    ThreadPool::getInstance().parallelFor(0, nbPoints, PARALLEL_GRAIN, [&](size_t, size_t chunkBegin, size_t chunkEnd){
+        for(size_t i = chunkBegin; i < chunkEnd; i++){
+            uint32_t x = std::min<double>((myPoints[i].height - minHeight) / step, (1u << order) - 1);
+            uint32_t y = std::min<double>(myPoints[i].angle * radii / step, (1u << order) - 1);
+            keys[i] = std::make_pair(hilbertIndex(x, y, order), (unsigned int) i);
+        }
+    });
+    std::sort(keys.begin(), keys.end());
+
+    //compose with a previous permutation if any
+    std::vector<unsigned int> previousIds = originalIds;
+    originalIds.resize(nbPoints);
+    newIds.resize(nbPoints);
+    std::vector<Z3i::RealPoint> sortedCloud(nbPoints);
+    std::vector<CylindricalPoint> sortedPoints(nbPoints);
+    std::vector<double> sortedDistances(nbPoints);
+    for(unsigned int i = 0; i < nbPoints; i++){
+        unsigned int from = keys[i].second;
+        sortedCloud[i] = pointCloud[from];
+        sortedPoints[i] = myPoints[from];
+        sortedDistances[i] = distances[from];
+        originalIds[i] = previousIds.empty() ? from : previousIds[from];
+        newIds[originalIds[i]] = i;
+    }
+    pointCloud.swap(sortedCloud);
+    myPoints.swap(sortedPoints);
+    distances.swap(sortedDistances);
 }
 
 
@@ -334,21 +479,24 @@ int SegmentationAbstract::getNbSector(){
 }
 
 double SegmentationAbstract::getRadius(unsigned int index){
-    return myPoints.at(index).radius;
+    return myPoints.at(newIds.empty() ? index : newIds.at(index)).radius;
 }
 double SegmentationAbstract::getLength(unsigned int index){
-    return myPoints.at(index).height;
+    return myPoints.at(newIds.empty() ? index : newIds.at(index)).height;
 }
 
 CylindricalPoint
 SegmentationAbstract::getPointInCylindric(unsigned int pId){
-    return myPoints.at(pId);
+    return myPoints.at(newIds.empty() ? pId : newIds.at(pId));
 }
 //-----------------------------------------------------
 //demo
 //-----------------------------------------------------
 std::vector<unsigned int> SegmentationAbstract::getPatch(unsigned int pointIndex){
     std::vector<unsigned int> pIds;
+    if(!newIds.empty()){
+        pointIndex = newIds.at(pointIndex);
+    }
     double patchAngle = arcLength / radii;
     //w = patch width, wh = patch height
     //build kdtree using pcl
@@ -400,7 +548,7 @@ std::vector<unsigned int> SegmentationAbstract::getPatch(unsigned int pointIndex
                continue;
                }
                */
-            pIds.push_back(foundedIndex);
+            pIds.push_back(getOriginalIndex(foundedIndex));
         }
     }
     return pIds;
@@ -18,6 +18,7 @@
 
 
 #include "CylindricalPoint.h"
+#include "ThresholdEngine.h"
 
 
 
@@ -41,6 +42,23 @@ struct CylindricalPointOrderArcLenght {
     bool operator() (CylindricalPoint p1, CylindricalPoint p2);
 };
 
+/** Brief
+ * Local orthonormal frame of one centerline segment, precomputed once so that
+ * the conversion of a point to cylindrical coordinates only needs dot products.
+ */
+struct SegmentFrame {
+    //first point of the segment
+    Z3i::RealPoint origin;
+    //unit direction of the segment (local Oz)
+    Z3i::RealPoint axis;
+    //unit vector mark, orthogonal to axis (local Ox, angle origin)
+    Z3i::RealPoint mark;
+    //unit binormal mark x axis (local Oy, positive angles)
+    Z3i::RealPoint binormal;
+    //arc length of the centerline at the beginning of the segment
+    double begin;
+};
+
 
 class SegmentationAbstract{
     public:
@@ -52,6 +70,10 @@ class SegmentationAbstract{
         std::vector<unsigned int> getDefect();
 
         std::vector<unsigned int> getDefect(double threshold);
+        /** Brief
+         * points whose distance is above their own threshold (thresholds in storage order)
+         */
+        std::vector<unsigned int> getDefect(const std::vector<double> &thresholds);
 
         std::vector<double> getDistances();
         std::vector<std::vector<unsigned int> > getCells();
@@ -64,6 +86,23 @@ class SegmentationAbstract{
         CylindricalPoint getPointInCylindric(unsigned int pId);
 
         double findThresholdRosin();
+        /** Brief
+         * threshold of the distances with the given method (see ThresholdEngine)
+         */
+        double findThreshold(ThresholdMethod method);
+
+        /** Brief
+         * method of the threshold used by getDefect()
+         */
+        void setThresholdMethod(ThresholdMethod method);
+        /** Brief
+         * write the histogram of the distances (hist2d, pointFile) when a threshold is computed
+         */
+        void setThresholdDump(bool dump);
+        /** Brief
+         * getDefect() uses thresholds computed on tiles of tileSize mm (see TileThreshold), 0 for a global threshold
+         */
+        void setTileThreshold(double tileSize);
 
 
         int getNbSegment();
@@ -74,6 +113,30 @@ class SegmentationAbstract{
          */
         unsigned int getSegment(const Z3i::RealPoint &aPoint);
 
+        /** Brief
+         * Enable the spatial reordering of the points (Hilbert curve on (height, angle))
+         * done by init after the conversion to cylindrical coordinates. The input point
+         * cloud is permuted in place; every index given to or returned by the public
+         * functions stays an index of the original point cloud.
+         */
+        void setSpatialReorder(bool reorder);
+
+        /** Brief
+         * return the index in the original point cloud of the point stored at index i
+         */
+        unsigned int getOriginalIndex(unsigned int i);
+
+        /** Brief
+         * Compute the angular width of the patches from the mean radius of the segment of
+         * each point instead of the mean radius of the whole log (arcLength stays constant)
+         */
+        void setAdaptivePatch(bool adaptive);
+
+        /** Brief
+         * Keep at most maxPoints points per patch (even stride subsample), 0 for no limit
+         */
+        void setMaxPatchPoints(unsigned int maxPoints);
+
     protected:
         /** Brief
          ** Allocate (resize) memory for array
@@ -81,6 +144,9 @@ class SegmentationAbstract{
         void allocate();
 
         virtual void allocateExtra() = 0;
+
+        template<typename F>
+        std::vector<unsigned int> compactDefects(const F &isDefect);
         /** Brief
          * Compute the equation of the relation between distance to center line and z
          * of patches associated to points
@@ -91,9 +157,22 @@ class SegmentationAbstract{
         void computeBeginOfSegment();
         void computeSegments();
 		    void convertToCcs();
+        /** Brief
+         * Sort pointCloud, myPoints and distances along a Hilbert curve on (height, angle)
+         * and keep the permutation (need convertToCcs)
+         */
+        void reorderPoints();
+        /** Brief
+         * Angular width of the patches of each segment (need convertToCcs)
+         */
+        void computeSegmentPatchAngles();
 
         //should be change to computeLocalCoordinate vectors
         void computeVectorMarks();
+        /** Brief
+         * Precompute the local frame of each segment (need beginOfSegment and vectMarks)
+         */
+        void computeSegmentFrames();
         virtual void computeDistances() = 0;
         void computePlaneNormals();
 
@@ -110,6 +189,11 @@ class SegmentationAbstract{
         getDirectionVector(const unsigned int &segmentId);
 
         void writeDebugInfo();
+
+        /** Brief
+         * write the time spent by each worker of the thread pool and the load imbalance
+         */
+        void reportBusyTimes(const std::vector<double> &busyTimes);
         /////////////////////////////////////////////////////////////////////////////////////////////////
         std::vector<Z3i::RealPoint> &pointCloud;
         std::vector<Z3i::RealPoint> &fiber;
@@ -137,6 +221,8 @@ class SegmentationAbstract{
         std::vector<Z3i::RealPoint> ns;
         //local vector Oy
         std::vector<Z3i::RealPoint> vectMarks;
+        //local frame of each segment used by convertToCcs
+        std::vector<SegmentFrame> segmentFrames;
 
         //coefficients of regressed lines, one line for each windows
         //a window = some bands consecutives
@@ -147,5 +233,25 @@ class SegmentationAbstract{
         double binWidth;
 
         double radii;
+
+        //true to reorder the points along a Hilbert curve after convertToCcs
+        bool spatialReorder = false;
+        //index in the original point cloud of each stored point (empty when not reordered)
+        std::vector<unsigned int> originalIds;
+        //index of storage of each point of the original point cloud (empty when not reordered)
+        std::vector<unsigned int> newIds;
+
+        //threshold of getDefect()
+        ThresholdMethod thresholdMethod = ROSIN_THRESHOLD;
+        bool thresholdDump = false;
+        //size of the tiles of the local thresholds (0 : global threshold)
+        double tileThresholdSize = 0.;
+
+        //patch angle from the radius of each segment
+        bool adaptivePatch = false;
+        //maximum number of points of a patch (0 : no limit)
+        unsigned int maxPatchPoints = 0;
+        //angular width of the patches of each segment
+        std::vector<double> segmentPatchAngles;
 };
 #endif
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+
+#include "SlidingPatchRegression.h"
+#include "Regression.h"
+#include "MultiThreadHelper.h"
+
+//number of bins along the height and along the angle of a patch
+#define BINS_PER_PATCH_HEIGHT 20
+#define BINS_PER_PATCH_ANGLE 5
+
+
+SlidingPatchRegression::Moments
+SlidingPatchRegression::Moments::operator+(const Moments &m) const {
+    Moments r;
+    r.n = n + m.n; r.sx = sx + m.sx; r.sy = sy + m.sy;
+    r.sxx = sxx + m.sxx; r.sxy = sxy + m.sxy; r.syy = syy + m.syy;
+    return r;
+}
+
+SlidingPatchRegression::Moments
+SlidingPatchRegression::Moments::operator-(const Moments &m) const {
+    Moments r;
+    r.n = n - m.n; r.sx = sx - m.sx; r.sy = sy - m.sy;
+    r.sxx = sxx - m.sxx; r.sxy = sxy - m.sxy; r.syy = syy - m.syy;
+    return r;
+}
+
+
+SlidingPatchRegression::SlidingPatchRegression(const std::vector<CylindricalPoint> &pts, double pHeight, double pAngle):
+    points(pts), patchHeight(pHeight), patchAngle(pAngle), minHeight(0.), meanRadius(0.), nbRows(0), nbCols(1){
+    if(points.empty()){
+        return;
+    }
+    auto minMaxHeight = std::minmax_element(points.begin(), points.end(),
+            [](const CylindricalPoint &p1, const CylindricalPoint &p2){ return p1.height < p2.height; });
+    minHeight = (*minMaxHeight.first).height;
+    double maxHeight = (*minMaxHeight.second).height;
+    for(unsigned int i = 0; i < points.size(); i++){
+        meanRadius += points[i].radius;
+    }
+    meanRadius /= points.size();
+
+    binHeight = patchHeight / BINS_PER_PATCH_HEIGHT;
+    nbRows = (int) std::floor((maxHeight - minHeight) / binHeight) + 1;
+    nbCols = std::max(1, (int) std::round(2*M_PI / (patchAngle / BINS_PER_PATCH_ANGLE)));
+    binAngle = 2*M_PI / nbCols;
+
+    binOf.resize(points.size());
+    ThreadPool::getInstance().parallelFor(0, points.size(), PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t i = lo; i < hi; i++){
+            int r = std::min(nbRows - 1, (int) std::floor((points[i].height - minHeight) / binHeight));
+            int c = std::min(nbCols - 1, std::max(0, (int) std::floor(points[i].angle / binAngle)));
+            binOf[i] = (unsigned int) r * nbCols + c;
+        }
+    });
+}
+
+
+void
+SlidingPatchRegression::computePrefixSums(const std::vector<char> &excluded){
+    size_t stride = nbCols + 1;
+    prefixSums.assign((size_t) (nbRows + 1) * stride, Moments());
+    //moments of each bin, stored at (r + 1, c + 1)
+    for(unsigned int i = 0; i < points.size(); i++){
+        if(excluded[i]){
+            continue;
+        }
+        double x = points[i].height - minHeight;
+        double y = points[i].radius - meanRadius;
+        Moments &m = prefixSums[(binOf[i] / nbCols + 1) * stride + binOf[i] % nbCols + 1];
+        m.n += 1; m.sx += x; m.sy += y;
+        m.sxx += x*x; m.sxy += x*y; m.syy += y*y;
+    }
+    ThreadPool &pool = ThreadPool::getInstance();
+    //prefix sums along the rows
+    pool.parallelFor(1, nbRows + 1, 64, [&](size_t, size_t lo, size_t hi){
+        for(size_t r = lo; r < hi; r++){
+            for(size_t c = 1; c < stride; c++){
+                prefixSums[r * stride + c] = prefixSums[r * stride + c] + prefixSums[r * stride + c - 1];
+            }
+        }
+    });
+    //then along the columns
+    pool.parallelFor(1, stride, 64, [&](size_t, size_t lo, size_t hi){
+        for(int r = 1; r <= nbRows; r++){
+            for(size_t c = lo; c < hi; c++){
+                prefixSums[r * stride + c] = prefixSums[r * stride + c] + prefixSums[(r - 1) * stride + c];
+            }
+        }
+    });
+}
+
+
+SlidingPatchRegression::Moments
+SlidingPatchRegression::getRectangle(int r0, int r1, int c0, int c1) const {
+    size_t stride = nbCols + 1;
+    return prefixSums[(r1 + 1) * stride + c1 + 1] - prefixSums[r0 * stride + c1 + 1]
+         - prefixSums[(r1 + 1) * stride + c0] + prefixSums[r0 * stride + c0];
+}
+
+
+SlidingPatchRegression::Moments
+SlidingPatchRegression::getPatchMoments(double height, double angle) const {
+    //bins whose center is in the window
+    int r0 = std::max(0, (int) std::ceil((height - patchHeight / 2 - minHeight) / binHeight - 0.5));
+    int r1 = std::min(nbRows - 1, (int) std::floor((height + patchHeight / 2 - minHeight) / binHeight - 0.5));
+    int c0 = (int) std::ceil((angle - patchAngle / 2) / binAngle - 0.5);
+    int c1 = (int) std::floor((angle + patchAngle / 2) / binAngle - 0.5);
+    if(r1 < r0 || c1 < c0){
+        return Moments();
+    }
+    if(c1 - c0 + 1 >= nbCols){
+        return getRectangle(r0, r1, 0, nbCols - 1);
+    }
+    //wrap around 2pi
+    c0 = ((c0 % nbCols) + nbCols) % nbCols;
+    c1 = ((c1 % nbCols) + nbCols) % nbCols;
+    if(c0 <= c1){
+        return getRectangle(r0, r1, c0, c1);
+    }
+    return getRectangle(r0, r1, c0, nbCols - 1) + getRectangle(r0, r1, 0, c1);
+}
+
+
+void
+SlidingPatchRegression::compute(std::vector<std::pair<double, double> > &coefficients){
+    size_t nbPoints = points.size();
+    coefficients.assign(nbPoints, std::pair<double, double>(0., 0.));
+    fallbackPoints.clear();
+    if(nbPoints == 0){
+        return;
+    }
+    ThreadPool &pool = ThreadPool::getInstance();
+    std::vector<char> excluded(nbPoints, 0);
+    std::vector<char> tooSmall(nbPoints, 0);
+    std::vector<char> needRansac(nbPoints, 0);
+
+    //first pass : outliers of the radius (>= mean + 2sd) in the patch of each point
+    computePrefixSums(excluded);
+    pool.parallelFor(0, nbPoints, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t i = lo; i < hi; i++){
+            Moments m = getPatchMoments(points[i].height, points[i].angle);
+            if(m.n < MIN_NB_POINTS){
+                tooSmall[i] = 1;
+                continue;
+            }
+            double mean = m.sy / m.n;
+            double sd = sqrt(std::max(0., (m.syy - m.n * mean * mean) / (m.n - 1)));
+            needRansac[i] = sd >= MAX_SD;
+            excluded[i] = points[i].radius - meanRadius >= mean + 2*sd;
+        }
+    });
+
+    //second pass : least squares on the remaining points
+    computePrefixSums(excluded);
+    pool.parallelFor(0, nbPoints, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t i = lo; i < hi; i++){
+            if(tooSmall[i] || needRansac[i]){
+                continue;
+            }
+            Moments m = getPatchMoments(points[i].height, points[i].angle);
+            if(m.n < 2){
+                continue;
+            }
+            double mx = m.sx / m.n;
+            double my = m.sy / m.n;
+            double cxx = m.sxx - m.n * mx * mx;
+            double cxy = m.sxy - m.n * mx * my;
+            double cyy = m.syy - m.n * my * my;
+            double a = cxx > 0 ? cxy / cxx : 0.;
+            double b = my - a * mx;
+            //median orthogonal distance to the line from the residual standard deviation
+            double sdResidual = sqrt(std::max(0., cyy - a * cxy) / m.n);
+            double median = 0.6745 * sdResidual / sqrt(a * a + 1);
+            //back to the original origin
+            coefficients[i].first = a;
+            coefficients[i].second = b + meanRadius - a * minHeight - median;
+        }
+    });
+    for(unsigned int i = 0; i < nbPoints; i++){
+        if(needRansac[i] && !tooSmall[i]){
+            fallbackPoints.push_back(i);
+        }
+    }
+}
+
+
+std::vector<unsigned int>
+SlidingPatchRegression::getFallbackPoints(){
+    return fallbackPoints;
+}
@@ -0,0 +1,76 @@
+#ifndef SLIDING_PATCH_REGRESSION_H
+#define SLIDING_PATCH_REGRESSION_H
+
+#include <vector>
+#include <utility>
+
+#include "CylindricalPoint.h"
+
+/**
+ * Patch regression (height -> radius line) of every point in O(1) per point.
+ * Points are binned over (height, angle) and the moments n, Sx, Sy, Sxx, Sxy, Syy
+ * of the bins are stored as 2D prefix sums, so that the moments of the patch
+ * around any point are read with four lookups (two when the patch wraps around 2pi).
+ * The patch is snapped to the bins whose center lies in the height x angle window.
+ *
+ * It follows Regression::PurgedlinearRegression (non RANSAC path) :
+ *  - first pass : mean and standard deviation of the radii of the patch, a point is an
+ *    outlier if its radius is >= mean + 2sd of its own patch,
+ *  - second pass : least squares line on the prefix sums of the non outlier points,
+ *  - the line is shifted by the median orthogonal distance, estimated from the residual
+ *    standard deviation (median of |r| = 0.6745 sd for gaussian residuals).
+ * Points whose patch has too few points get (0, 0) like the exact path, points whose
+ * patch needs RANSAC (sd >= MAX_SD) are listed by getFallbackPoints.
+ **/
+class SlidingPatchRegression{
+    public:
+        SlidingPatchRegression(const std::vector<CylindricalPoint> &points, double patchHeight, double patchAngle);
+
+        /**
+        compute the coefficients (slope, intercept) of the line of each point
+        **/
+        void compute(std::vector<std::pair<double, double> > &coefficients);
+
+        /**
+        return the points which must be computed by the exact path
+        **/
+        std::vector<unsigned int> getFallbackPoints();
+
+    protected:
+        struct Moments{
+            double n = 0., sx = 0., sy = 0., sxx = 0., sxy = 0., syy = 0.;
+            Moments operator+(const Moments &m) const;
+            Moments operator-(const Moments &m) const;
+        };
+
+        /**
+        build the prefix sums of the moments of the points not excluded
+        **/
+        void computePrefixSums(const std::vector<char> &excluded);
+        /**
+        return the moments of the patch centered on (height, angle)
+        **/
+        Moments getPatchMoments(double height, double angle) const;
+        /**
+        return the moments of the bins [r0, r1] x [c0, c1]
+        **/
+        Moments getRectangle(int r0, int r1, int c0, int c1) const;
+
+        const std::vector<CylindricalPoint> &points;
+        double patchHeight;
+        double patchAngle;
+        double minHeight;
+        //origin of the radii, reduces cancellation in the moments
+        double meanRadius;
+        double binHeight;
+        double binAngle;
+        int nbRows;
+        int nbCols;
+        //bin of each point
+        std::vector<unsigned int> binOf;
+        //prefix sums, (nbRows + 1) x (nbCols + 1)
+        std::vector<Moments> prefixSums;
+        std::vector<unsigned int> fallbackPoints;
+};
+
+#endif // SLIDING_PATCH_REGRESSION_H
@@ -0,0 +1,30 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <cstddef>
+
+/**
+ * Non owning view of a contiguous array (pointer + size), built implicitly from a
+ * std::vector. Lets the regression functions read the patch buffers without copies.
+ **/
+template<typename T>
+class Span{
+    public:
+        Span(): ptr(nullptr), n(0){}
+        Span(T *p, size_t size): ptr(p), n(size){}
+        template<typename V>
+        Span(V &v): ptr(v.data()), n(v.size()){}
+
+        T *data() const { return ptr; }
+        size_t size() const { return n; }
+        bool empty() const { return n == 0; }
+        T *begin() const { return ptr; }
+        T *end() const { return ptr + n; }
+        T &operator[](size_t i) const { return ptr[i]; }
+
+    protected:
+        T *ptr;
+        size_t n;
+};
+
+#endif // SPAN_H
@@ -7,37 +7,47 @@ Statistic::Statistic(){
 }
 
 double Statistic::standardDeviation(const std::vector<double> &v, const double mean){
+    return standardDeviation(v.data(), v.size(), mean);
+}
+
+double Statistic::getMean(const std::vector<double> &v){
+    return getMean(v.data(), v.size());
+}
+
+double Statistic::standardDeviation(const double *v, size_t n, const double mean){
     double s = 0.0;
-    for (size_t i = 0; i < v.size(); i++)
+    for (size_t i = 0; i < n; i++)
     {
         s += (v[i] - mean) * (v[i] - mean);
     }
-    return sqrt(s/(v.size() - 1));
+    return sqrt(s/(n - 1));
 }
 
-double Statistic::getMean(const std::vector<double> &v){
+double Statistic::getMean(const double *v, size_t n){
     //calculate mean
     double sum = 0.0;
-    for (unsigned int i = 0; i < v.size(); i++)
+    for (size_t i = 0; i < n; i++)
     {
         sum += v[i];
     }
 
-    return sum / v.size();
+    return sum / n;
 }
 
 double Statistic::getMedian(std::vector<double> v){
-    double median=0.0;
-    unsigned int size = v.size();
+    return getMedianInPlace(v.data(), v.data() + v.size());
+}
+
+double Statistic::getMedianInPlace(double *begin, double *end){
+    size_t size = end - begin;
     if (size == 0){
-        median=0.;  // Undefined, really.
-    }else{
-        std::sort(v.begin(), v.end());
-        if (size % 2 == 0){
-            median=(v.at(size / 2 - 1) + v.at(size / 2)) / 2;
-        }else{
-            median=v.at(size / 2);
-        }
+        return 0.;  // Undefined, really.
+    }
+    double *middle = begin + size / 2;
+    std::nth_element(begin, middle, end);
+    if (size % 2 == 0){
+        //the lower middle value is the largest of the lower half
+        return (*std::max_element(begin, middle) + *middle) / 2;
     }
-    return median;
+    return *middle;
 }
@@ -2,6 +2,7 @@
 #define STATISTIC_H
 
 #include<vector>
+#include<cstddef>
 
 class Statistic
 {
@@ -9,7 +10,13 @@ public:
     Statistic();
     static double standardDeviation(const std::vector<double> &v, double mean);
     static double getMean(const std::vector<double> &v);
+    static double standardDeviation(const double *v, size_t n, double mean);
+    static double getMean(const double *v, size_t n);
     static double getMedian(std::vector<double> v);
+    /**
+    median of [begin, end) by selection (nth_element), the range is reordered
+    **/
+    static double getMedianInPlace(double *begin, double *end);
 };
 
 #endif // STATISTIC_H
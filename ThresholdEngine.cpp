@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "DGtal/base/Common.h"
+
+#include "ThresholdEngine.h"
+#include "MultiThreadHelper.h"
+#include "IOHelper.h"
+
+using namespace DGtal;
+
+ThresholdEngine::ThresholdEngine(double aBinWidth): binWidth(aBinWidth){
+}
+
+
+void
+ThresholdEngine::build(const std::vector<double> &values){
+    build(values.data(), values.size());
+}
+
+
+void
+ThresholdEngine::build(const double *values, size_t n){
+    histogram.clear();
+    minValue = 0.;
+    maxValue = 0.;
+    if(n == 0){
+        return;
+    }
+    ThreadPool &pool = ThreadPool::getInstance();
+    //a few chunks per thread : one histogram per chunk
+    size_t grain = std::max((size_t) PARALLEL_GRAIN, n / (4 * pool.getNbThreads()) + 1);
+    size_t nbChunks = ThreadPool::getNbChunks(0, n, grain);
+
+    std::vector<double> chunkMin(nbChunks, std::numeric_limits<double>::max());
+    std::vector<double> chunkMax(nbChunks, -std::numeric_limits<double>::max());
+    pool.parallelFor(0, n, grain, [&](size_t chunkId, size_t lo, size_t hi){
+        double mi = chunkMin[chunkId], ma = chunkMax[chunkId];
+        for(size_t i = lo; i < hi; i++){
+            mi = std::min(mi, values[i]);
+            ma = std::max(ma, values[i]);
+        }
+        chunkMin[chunkId] = mi;
+        chunkMax[chunkId] = ma;
+    });
+    minValue = *std::min_element(chunkMin.begin(), chunkMin.end());
+    maxValue = *std::max_element(chunkMax.begin(), chunkMax.end());
+
+    size_t nbInterval = std::max(1, (int) ((maxValue - minValue) / binWidth));
+    std::vector<unsigned int> chunkHistograms(nbChunks * nbInterval, 0);
+    pool.parallelFor(0, n, grain, [&](size_t chunkId, size_t lo, size_t hi){
+        unsigned int *h = chunkHistograms.data() + chunkId * nbInterval;
+        for(size_t i = lo; i < hi; i++){
+            size_t index = (size_t) ((values[i] - minValue) / binWidth);
+            //the maximum (and rounding) can give index == nbInterval
+            h[std::min(index, nbInterval - 1)]++;
+        }
+    });
+    histogram.assign(nbInterval, 0);
+    pool.parallelFor(0, nbInterval, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t c = 0; c < nbChunks; c++){
+            const unsigned int *h = chunkHistograms.data() + c * nbInterval;
+            for(size_t b = lo; b < hi; b++){
+                histogram[b] += h[b];
+            }
+        }
+    });
+}
+
+
+unsigned int
+ThresholdEngine::rosinIndex(const unsigned int *histogram, size_t nbBins){
+    if(nbBins == 0){
+        return 0;
+    }
+    const unsigned int *maxFreq = std::max_element(histogram, histogram + nbBins);
+    int maxFreqValue = *maxFreq;
+    unsigned int maxFreqIndex = maxFreq - histogram;
+
+    unsigned int lastIndex = nbBins - 1;
+    int lastValue = histogram[lastIndex];
+    for(unsigned int i = maxFreqIndex; i < nbBins; i++){
+        if(histogram[i] == 0){
+            lastIndex = i;
+            lastValue = 0;
+            break;
+        }
+    }
+
+    double valueDiff = lastValue - maxFreqValue;
+    double valueDiff2 = valueDiff *valueDiff;
+    double indexDiff = (double) lastIndex - maxFreqIndex;
+    double indexDiff2 = indexDiff * indexDiff;
+    unsigned int bestThresIndex = maxFreqIndex;
+    double bestDist = 0;
+    for (unsigned int i = maxFreqIndex; i < lastIndex; i++){
+        double dist = std::abs(valueDiff *  i - indexDiff*histogram[i] + (double) maxFreqValue*lastIndex - (double) maxFreqIndex * lastValue)/
+            sqrt(valueDiff2 + indexDiff2 );
+        if(dist > bestDist){
+            bestDist = dist;
+            bestThresIndex = i;
+        }
+    }
+    return bestThresIndex;
+}
+
+
+unsigned int
+ThresholdEngine::otsuIndex(const unsigned int *histogram, size_t nbBins){
+    double total = 0., sumAll = 0.;
+    for(size_t i = 0; i < nbBins; i++){
+        total += histogram[i];
+        sumAll += (double) i * histogram[i];
+    }
+    double weightLow = 0., sumLow = 0.;
+    double bestVariance = -1.;
+    unsigned int bestIndex = 0;
+    for(size_t i = 0; i + 1 < nbBins; i++){
+        weightLow += histogram[i];
+        sumLow += (double) i * histogram[i];
+        double weightHigh = total - weightLow;
+        if(weightLow == 0 || weightHigh == 0){
+            continue;
+        }
+        double meanDiff = sumLow / weightLow - (sumAll - sumLow) / weightHigh;
+        double variance = weightLow * weightHigh * meanDiff * meanDiff;
+        if(variance > bestVariance){
+            bestVariance = variance;
+            bestIndex = i;
+        }
+    }
+    return bestIndex;
+}
+
+
+double
+ThresholdEngine::rosin() const {
+    unsigned int bestThresIndex = rosinIndex(histogram.data(), histogram.size());
+    if(dump){
+        dumpRosin(bestThresIndex);
+    }
+    return bestThresIndex * binWidth + minValue;
+}
+
+
+double
+ThresholdEngine::otsu() const {
+    //upper bound of the lower class
+    return (otsuIndex(histogram.data(), histogram.size()) + 1) * binWidth + minValue;
+}
+
+
+double
+ThresholdEngine::getThreshold(ThresholdMethod method) const {
+    double threshold = method == OTSU_THRESHOLD ? otsu() : rosin();
+    trace.info()<<"threshold ("<<(method == OTSU_THRESHOLD ? "otsu" : "rosin")<<"): "<<threshold<<std::endl;
+    return threshold;
+}
+
+
+void
+ThresholdEngine::dumpRosin(unsigned int bestThresIndex) const {
+    if(histogram.empty()){
+        return;
+    }
+    unsigned int maxFreqIndex = std::max_element(histogram.begin(), histogram.end()) - histogram.begin();
+    double maxFreqValue = histogram[maxFreqIndex];
+    unsigned int lastIndex = histogram.size() - 1;
+    for(unsigned int i = maxFreqIndex; i < histogram.size(); i++){
+        if(histogram[i] == 0){
+            lastIndex = i;
+            break;
+        }
+    }
+    double lastValue = histogram[lastIndex];
+    double res = binWidth;
+    std::vector<std::pair<double, double>> forPlot;
+    forPlot.push_back(std::pair<double, double>(maxFreqIndex * res + minValue, maxFreqValue));
+    forPlot.push_back(std::pair<double, double>(lastIndex * res + minValue, lastValue));
+    forPlot.push_back(std::pair<double, double>(bestThresIndex * res + minValue, histogram[bestThresIndex]));
+    //projection of the best point on the line between the peak and the last point
+    if(lastIndex != maxFreqIndex){
+        double a = (lastValue - maxFreqValue)/(lastIndex - maxFreqIndex);
+        double b = maxFreqValue - a * maxFreqIndex;
+        double x2 = a != 0 ? (histogram[bestThresIndex] + bestThresIndex/a - b)/(a + 1/a) : bestThresIndex;
+        forPlot.push_back(std::pair<double, double>(x2 * res + minValue, b + a*x2));
+    }
+    IOHelper::export2Text(forPlot, "pointFile");
+
+    std::vector<std::pair<double, double>> histForPlot;
+    for(unsigned int i = 0; i < histogram.size(); i++){
+        histForPlot.push_back(std::pair<double, double>(i * res + minValue, histogram[i]));
+    }
+    IOHelper::export2Text(histForPlot, "hist2d");
+}
+
+
+void
+ThresholdEngine::setDump(bool aDump){
+    dump = aDump;
+}
+
+
+const std::vector<unsigned int> &
+ThresholdEngine::getHistogram() const {
+    return histogram;
+}
+
+
+double
+ThresholdEngine::getMin() const {
+    return minValue;
+}
+
+
+double
+ThresholdEngine::getMax() const {
+    return maxValue;
+}
+
+
+double
+ThresholdEngine::getBinWidth() const {
+    return binWidth;
+}
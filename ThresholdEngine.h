@@ -0,0 +1,68 @@
+#ifndef THRESHOLD_ENGINE_H
+#define THRESHOLD_ENGINE_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+//method used to select a threshold on the histogram of the distances
+enum ThresholdMethod {
+  //corner of the histogram (Rosin), the default
+  ROSIN_THRESHOLD,
+  //maximum between class variance (Otsu)
+  OTSU_THRESHOLD
+};
+
+/**
+ * Histogram of a set of values and threshold selection.
+ * build() does the min/max and the histogram in parallel : each chunk of the thread pool
+ * fills its own histogram, they are merged at the end. The bins have the width binWidth
+ * from the minimum, the maximum goes to the last bin.
+ * The selectors also work on any histogram (see the static versions), they return a bin index.
+ **/
+class ThresholdEngine{
+    public:
+        ThresholdEngine(double binWidth);
+
+        void build(const std::vector<double> &values);
+        void build(const double *values, size_t n);
+
+        /**
+        threshold (a value) with the chosen method
+        **/
+        double getThreshold(ThresholdMethod method) const;
+        double rosin() const;
+        double otsu() const;
+
+        /**
+        write the histogram (hist2d) and the points of the Rosin construction (pointFile)
+        in the current directory when the thresholds are selected
+        **/
+        void setDump(bool dump);
+
+        const std::vector<unsigned int> &getHistogram() const;
+        double getMin() const;
+        double getMax() const;
+        double getBinWidth() const;
+
+        /**
+        bin of the threshold of the histogram of nbBins bins, Rosin method : bin farthest
+        from the line between the peak and the first empty bin after it (or the last bin)
+        **/
+        static unsigned int rosinIndex(const unsigned int *histogram, size_t nbBins);
+        /**
+        last bin of the lower class, Otsu method
+        **/
+        static unsigned int otsuIndex(const unsigned int *histogram, size_t nbBins);
+
+    protected:
+        void dumpRosin(unsigned int bestThresIndex) const;
+
+        double binWidth;
+        double minValue = 0.;
+        double maxValue = 0.;
+        std::vector<unsigned int> histogram;
+        bool dump = false;
+};
+
+#endif // THRESHOLD_ENGINE_H
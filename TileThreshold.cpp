@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "DGtal/base/Common.h"
+
+#include "TileThreshold.h"
+#include "CsrIndex.h"
+#include "MultiThreadHelper.h"
+
+//tiles with less points use the global threshold
+#define TILE_MIN_POINTS 200
+//chunks of tiles per thread, several so that the stealing balances tiles of different sizes
+#define TILE_CHUNKS_PER_THREAD 4
+
+using namespace DGtal;
+
+TileThreshold::TileThreshold(double aTileSize, double aBinWidth, ThresholdMethod aMethod):
+    tileSize(aTileSize), binWidth(aBinWidth), method(aMethod){
+}
+
+
+void
+TileThreshold::compute(const std::vector<CylindricalPoint> &points, const std::vector<double> &distances,
+                       double meanRadius, std::vector<double> &thresholds){
+    auto start = std::chrono::steady_clock::now();
+    size_t nbPoints = points.size();
+    thresholds.assign(nbPoints, 0.);
+    if(nbPoints == 0){
+        return;
+    }
+    ThreadPool &pool = ThreadPool::getInstance();
+
+    //global histogram : bins shared by all tiles and fallback threshold
+    ThresholdEngine global(binWidth);
+    global.build(distances);
+    double globalThreshold = global.getThreshold(method);
+    size_t nbBins = global.getHistogram().size();
+    double minValue = global.getMin();
+
+    //tiles
+    auto minMaxHeight = std::minmax_element(points.begin(), points.end(),
+            [](const CylindricalPoint &p1, const CylindricalPoint &p2){ return p1.height < p2.height; });
+    double minHeight = (*minMaxHeight.first).height;
+    double maxHeight = (*minMaxHeight.second).height;
+    int nbRows = (int) std::floor((maxHeight - minHeight) / tileSize) + 1;
+    int nbCols = std::max(1, (int) std::round(2*M_PI * meanRadius / tileSize));
+    double angleStep = 2*M_PI / nbCols;
+    size_t nbTiles = (size_t) nbRows * nbCols;
+
+    std::vector<unsigned int> tileOf(nbPoints);
+    pool.parallelFor(0, nbPoints, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t i = lo; i < hi; i++){
+            int r = std::min(nbRows - 1, (int) std::floor((points[i].height - minHeight) / tileSize));
+            int c = std::min(nbCols - 1, std::max(0, (int) std::floor(points[i].angle / angleStep)));
+            tileOf[i] = (unsigned int) r * nbCols + c;
+        }
+    });
+    CsrIndex tiles;
+    tiles.build(nbTiles, tileOf);
+
+    //histogram and threshold of each tile, one histogram per chunk reused by its tiles
+    size_t nbChunksWanted = (size_t) TILE_CHUNKS_PER_THREAD * pool.getNbThreads();
+    size_t tileGrain = std::max((size_t) 1, (nbTiles + nbChunksWanted - 1) / nbChunksWanted);
+    std::vector<unsigned int> histograms(ThreadPool::getNbChunks(0, nbTiles, tileGrain) * nbBins);
+    std::vector<double> tileThresholds(nbTiles, globalThreshold);
+    std::vector<double> tileTimes(nbTiles, 0.);
+    pool.parallelFor(0, nbTiles, tileGrain, [&](size_t chunkId, size_t lo, size_t hi){
+        unsigned int *h = histograms.data() + chunkId * nbBins;
+        for(size_t t = lo; t < hi; t++){
+            auto tileStart = std::chrono::steady_clock::now();
+            if(tiles.cellSize(t) >= TILE_MIN_POINTS){
+                std::fill(h, h + nbBins, 0u);
+                for(const unsigned int *p = tiles.cellBegin(t); p != tiles.cellEnd(t); p++){
+                    size_t index = (size_t) ((distances[*p] - minValue) / binWidth);
+                    h[std::min(index, nbBins - 1)]++;
+                }
+                if(method == OTSU_THRESHOLD){
+                    tileThresholds[t] = (ThresholdEngine::otsuIndex(h, nbBins) + 1) * binWidth + minValue;
+                }else{
+                    tileThresholds[t] = ThresholdEngine::rosinIndex(h, nbBins) * binWidth + minValue;
+                }
+            }
+            tileTimes[t] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tileStart).count();
+        }
+    });
+
+    //average with the neighbours, weighted by the number of points
+    std::vector<double> smoothed(nbTiles, globalThreshold);
+    pool.parallelFor(0, nbTiles, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t t = lo; t < hi; t++){
+            int r = t / nbCols;
+            int c = t % nbCols;
+            double sum = 0., weight = 0.;
+            for(int dr = -1; dr <= 1; dr++){
+                if(r + dr < 0 || r + dr >= nbRows){
+                    continue;
+                }
+                for(int dc = -1; dc <= 1; dc++){
+                    //the angle wraps, avoid counting a tile twice when there are less than 3 columns
+                    if(nbCols < 3 && dc != 0 && (c + dc + nbCols) % nbCols == c){
+                        continue;
+                    }
+                    size_t n = (size_t) (r + dr) * nbCols + (c + dc + nbCols) % nbCols;
+                    double w = tiles.cellSize(n) >= TILE_MIN_POINTS ? tiles.cellSize(n) : 0.;
+                    sum += w * tileThresholds[n];
+                    weight += w;
+                }
+            }
+            if(weight > 0){
+                smoothed[t] = sum / weight;
+            }
+        }
+    });
+
+    //bilinear interpolation between the centers of the tiles
+    pool.parallelFor(0, nbPoints, PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t i = lo; i < hi; i++){
+            double fr = (points[i].height - minHeight) / tileSize - 0.5;
+            int r0 = std::min(std::max(0, (int) std::floor(fr)), nbRows - 1);
+            int r1 = std::min(r0 + 1, nbRows - 1);
+            double t = std::min(1., std::max(0., fr - r0));
+            double fc = points[i].angle / angleStep - 0.5;
+            int c0 = (((int) std::floor(fc)) % nbCols + nbCols) % nbCols;
+            int c1 = (c0 + 1) % nbCols;
+            double u = fc - std::floor(fc);
+            thresholds[i] = (1 - t) * ((1 - u) * smoothed[(size_t) r0 * nbCols + c0] + u * smoothed[(size_t) r0 * nbCols + c1])
+                          + t * ((1 - u) * smoothed[(size_t) r1 * nbCols + c0] + u * smoothed[(size_t) r1 * nbCols + c1]);
+        }
+    });
+
+    double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    double sumTileTimes = 0., maxTileTime = 0.;
+    for(size_t t = 0; t < nbTiles; t++){
+        sumTileTimes += tileTimes[t];
+        maxTileTime = std::max(maxTileTime, tileTimes[t]);
+    }
+    auto minMaxThreshold = std::minmax_element(smoothed.begin(), smoothed.end());
+    trace.info()<<"tile thresholds : "<<nbRows<<" x "<<nbCols<<" tiles, "<<*minMaxThreshold.first<<" to "
+                <<*minMaxThreshold.second<<" (global "<<globalThreshold<<")"<<std::endl;
+    trace.info()<<"tile thresholds time : "<<duration<<" ms, per tile mean "<<sumTileTimes / nbTiles
+                <<" ms max "<<maxTileTime<<" ms"<<std::endl;
+}
@@ -0,0 +1,34 @@
+#ifndef TILE_THRESHOLD_H
+#define TILE_THRESHOLD_H
+
+#include <vector>
+
+#include "CylindricalPoint.h"
+#include "ThresholdEngine.h"
+
+/**
+ * Threshold of the distances per point from local histograms.
+ * The (height, angle) surface is cut in tiles of tileSize x tileSize mm (arc length at the mean
+ * radius). All tiles share the bins of the global histogram, so the histograms are one flat
+ * array filled tile-parallel. The threshold of each tile is selected on its histogram, then
+ * averaged with its 8 neighbours (weighted by their number of points, the angle wraps around),
+ * and the threshold of a point is the bilinear interpolation of the thresholds of the 4 tile
+ * centers around it. Tiles with too few points take the global threshold.
+ **/
+class TileThreshold{
+    public:
+        TileThreshold(double tileSize, double binWidth, ThresholdMethod method);
+
+        /**
+        threshold of each point
+        **/
+        void compute(const std::vector<CylindricalPoint> &points, const std::vector<double> &distances,
+                     double meanRadius, std::vector<double> &thresholds);
+
+    protected:
+        double tileSize;
+        double binWidth;
+        ThresholdMethod method;
+};
+
+#endif // TILE_THRESHOLD_H
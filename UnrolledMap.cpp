@@ -3,9 +3,12 @@
 #include <algorithm>
 #include "CylindricalPoint.h"
 #include "SegmentationAbstract.h"
+#include "MultiThreadHelper.h"
 
 //#include <opencv2/opencv.hpp>
 #include <chrono>
+#include <numeric>
+#include <limits>
 #include "DGtal/images/ImageContainerBySTLVector.h"
 #include "DGtal/images/ArrayImageAdapter.h"
 #include "DGtal/images/ConstImageAdapter.h"
@@ -16,13 +19,68 @@
 #include "DGtal/io/colormaps/HueShadeColorMap.h"
 using namespace DGtal;
 
+//columns of the image per chunk
+#define COLUMN_GRAIN 64
+//rows of the image per chunk
+#define ROW_GRAIN 16
+
+/**
+call f(chunkId, r) on each row r (from 0) of the domain, by bands of ROW_GRAIN rows on the thread pool.
+Pixel (x, r) of an image of this domain is image[r*width+x] (DGtal stores the rows one after the other).
+**/
+template<typename F>
+static void
+forEachRowBand(const Z2i::Domain &domain, const F &f){
+    size_t height=domain.upperBound()[1]-domain.lowerBound()[1]+1;
+    ThreadPool::getInstance().parallelFor(0, height, ROW_GRAIN, [&](size_t chunkId, size_t lo, size_t hi){
+        for(size_t r = lo; r < hi; r++){
+            f(chunkId, r);
+        }
+    });
+}
+
+static int
+getWidth(const Z2i::Domain &domain){
+    return domain.upperBound()[0]-domain.lowerBound()[0]+1;
+}
+
+static double
+getElapsedMs(const std::chrono::steady_clock::time_point &start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename F>
+void
+UnrolledMap::computeColumnBounds(int nbRows, int nbCols, const F &isSet, std::vector<int> &first, std::vector<int> &last){
+    first.assign(nbCols, nbRows);
+    last.assign(nbCols, -1);
+    ThreadPool::getInstance().parallelFor(0, nbCols, COLUMN_GRAIN, [&](size_t, size_t lo, size_t hi){
+        for(size_t j = lo; j < hi; j++){
+            int i=0;
+            while(i<nbRows && !isSet(i,j)){
+                i++;
+            }
+            if(i==nbRows){
+                continue;
+            }
+            first[j]=i;
+            i=nbRows-1;
+            while(!isSet(i,j)){
+                i--;
+            }
+            last[j]=i;
+        }
+    });
+}
+
 void
 UnrolledMap::computeDicretisation(){
     CylindricalPointOrder heightOrder;
     auto minMaxHeight = std::minmax_element(CPoints.begin(), CPoints.end(), heightOrder);
     double minHeight = (*minMaxHeight.first).height;
     double maxHeight = (*minMaxHeight.second).height;
-    height_div=roundf(maxHeight-minHeight);
+    //one cell every heightPitch mm along the height, every arcPitch mm along the arc at the mean radius
+    height_div=std::max(1.f,roundf((maxHeight-minHeight)/heightPitch));
     //compute angle discretisation
     double meanRadius=0.;
     CylindricalPoint mpCurrent;
@@ -31,31 +89,33 @@ UnrolledMap::computeDicretisation(){
         meanRadius+=mpCurrent.radius;
     }
     meanRadius/=CPoints.size();
-    angle_div=roundf(2*M_PI*meanRadius);
+    angle_div=std::max(1.f,roundf(2*M_PI*meanRadius/arcPitch));
     //compute min and max angle
     CylindricalPointOrderAngle angleOrder;
     auto minMaxAngle = std::minmax_element(CPoints.begin(), CPoints.end(), angleOrder);
     double minAngle = (*minMaxAngle.first).angle;
     double maxAngle = (*minMaxAngle.second).angle;
 
-    //preallocate size for unrolled map
-    unrolled_surface.resize(height_div);
-    for (int i = 0; i < height_div; ++i){
-        unrolled_surface[i].resize(angle_div);
-    }
-    //fill unrolled map
+    //cell of each point : counting pass then scatter pass in CSR
     trace.info()<<"Compute discretisation..."<<std::endl;
-    int posAngle, posHeight;
-    for(unsigned int i = 0; i < CPoints.size(); i++){
-        mpCurrent=CPoints.at(i);
-        //change range [minAngle,maxAngle] to [0,angle_div-1]
-        posAngle=roundf((((angle_div-1)/(maxAngle-minAngle))*(mpCurrent.angle-(maxAngle)))+(angle_div-1));
-        //change range [minHeight,maxHeight] to [0,height_div-1]
-        posHeight=roundf((((height_div-1)/(maxHeight-minHeight))*(mpCurrent.height-maxHeight))+(height_div-1));
-        //add index point to the unrolled_surface
-        unrolled_surface[posHeight][posAngle].push_back(i);
-    }
-      trace.info()<<"Discretisation : [ "<<height_div<<" ; "<<angle_div<<" ]"<<std::endl;
+    std::vector<unsigned int> cellOf(CPoints.size());
+    ThreadPool::getInstance().parallelFor(0, CPoints.size(), PARALLEL_GRAIN, [&](size_t, size_t lo, size_t hi){
+        int posAngle, posHeight;
+        for(size_t i = lo; i < hi; i++){
+            const CylindricalPoint &mp = CPoints[i];
+            //change range [minAngle,maxAngle] to [0,angle_div-1]
+            posAngle=roundf((((angle_div-1)/(maxAngle-minAngle))*(mp.angle-(maxAngle)))+(angle_div-1));
+            //change range [minHeight,maxHeight] to [0,height_div-1]
+            posHeight=roundf((((height_div-1)/(maxHeight-minHeight))*(mp.height-maxHeight))+(height_div-1));
+            cellOf[i]=(unsigned int) posHeight*angle_div+posAngle;
+        }
+    });
+    unrolled_surface.build((size_t) height_div*angle_div, cellOf);
+    //rows of the first and last non empty cells of each column, for detectCellsIn
+    computeColumnBounds(height_div, angle_div, [&](int i, int j){
+        return !getCell(i,j).empty();
+    }, firstRowIn, lastRowIn);
+      trace.info()<<"Discretisation : [ "<<height_div<<" ; "<<angle_div<<" ] pixel pitch : [ "<<heightPitch<<" ; "<<arcPitch<<" ] mm"<<std::endl;
 }
 
 /*TODO : change openCV*/
@@ -116,188 +176,145 @@ UnrolledMap::makeGroundTruthImage(std::vector<int> gtId,std::string outputFileNa
 
 bool
 UnrolledMap::detectCellsIn(unsigned int i, unsigned int j){
-    //A cell is 'in' if we can't reach the top image or the bot image with empty cellsgrayscalemap.at<uchar>(i, j) = grayscaleValue;
-    bool CellsIn=true;
-
-    std::vector<unsigned int > tempUp = unrolled_surface[i][j];
-    std::vector<unsigned int > tempDown = unrolled_surface[i][j];
-
-    //ind for reach the top image
-    unsigned int iUp=i;
-    //ind for reach the bot image
-    unsigned int iDown=i;
-    //decrement ind while cells is empty
-    while(tempUp.empty() && (iUp>0)){
-        iUp-=1;
-        tempUp=unrolled_surface[iUp][j];
-    }
-    //increment ind while cells is empty
-    while(tempDown.empty() && (iDown<height_div-1)){
-        iDown+=1;
-        tempDown=unrolled_surface[iDown][j];
-    }
-    //check reached top of bot
-    if((iUp==0 && tempUp.empty()) || (iDown==height_div-1 && tempDown.empty())){
-        CellsIn=false;
-    }
-    return CellsIn;
+    //A cell is 'in' if we can't reach the top image or the bot image with empty cells,
+    //i.e. if it is between the first and the last non empty cells of its column
+    return firstRowIn[j]<=(int)i && (int)i<=lastRowIn[j];
 }
 
 std::vector<unsigned int >
 UnrolledMap::getIndPointsInLowerResolution(unsigned int i,unsigned int j,int dF){
-    int pad=pow(2,dF);
     std::vector<unsigned int > outPutInd;
-    int topLeftCornerHeight,topLeftCornerTheta;
-    topLeftCornerHeight=(i/pad)*pad;
-    topLeftCornerTheta=(j/pad)*pad;
-    //loop on cells (of unrolledSurace) in region containing (i,j)
-    for( int k = topLeftCornerHeight; k < (topLeftCornerHeight+pad); k++){
-        for( int l = topLeftCornerTheta; l < (topLeftCornerTheta+pad); l++){
-            //check if cells of region is in unrolled surface -> no segmentation fault
-            if((k < height_div)&&(l < angle_div)){
-                //unlarge  vector size
-                outPutInd.reserve(outPutInd.size() + unrolled_surface[k][l].size());
-                //concat vector
-                outPutInd.insert(outPutInd.end(), unrolled_surface[k][l].begin(),  unrolled_surface[k][l].end());
-            }
-        }
-    }
+    //concat the cells of the region containing (i,j)
+    forEachInLowerResolution(i,j,pow(2,dF),[&](unsigned int indP){
+        outPutInd.push_back(indP);
+    });
     return outPutInd;
 }
 
 
 
-std::vector<unsigned int>
+Span<const unsigned int>
 UnrolledMap::getPointsUnrolled_surface(unsigned int i,unsigned int j){
 
-    return unrolled_surface[i+maxIndTop][j];
+    return getCell(i+maxIndTop,j);
 }
 
-double
-UnrolledMap::sumReliefRepresentation(unsigned int i, unsigned int j,int dF){
-    assert(dF!=0);
-    double sumRelief=0.;
-    std::vector<unsigned int> v = getIndPointsInLowerResolution(i,j,dF);
-    if(!v.empty()){
-        unsigned int IndP;
-        for(std::vector<unsigned int>::iterator it = std::begin(v); it != std::end(v); ++it) {
-            IndP=*it;
-            sumRelief+=reliefRepresentation.at(IndP);
-        }
+template<typename... Reducers>
+void
+UnrolledMap::reduceReliefRepresentation(unsigned int i, unsigned int j, int dF, std::vector<double> &values, double *out) const {
+    typedef CellReducer<Reducers...> Reduction;
+    CellStats stats;
+    if(!Reduction::needValues && dF<reliefPyramid.getNbLevels()){
+        //max, sum and count of the region are in the pyramid
+        stats=reliefPyramid.getStats(dF,i,j);
     }else{
-        sumRelief=-1;
+        stats.max=INT_MIN;
+        stats.sum=0.;
+        stats.count=0;
+        values.clear();
+        forEachInLowerResolution(i,j,pow(2,dF),[&](unsigned int indP){
+            double relief=reliefRepresentation[indP];
+            stats.max=std::max(stats.max,relief);
+            stats.sum+=relief;
+            stats.count++;
+            if(Reduction::needValues){
+                values.push_back(relief);
+            }
+        });
+        stats.values=values.data();
     }
-    return sumRelief;
+    Reduction::reduce(stats,out);
 }
 
-
-
-double
-UnrolledMap::meansReliefRepresentation(unsigned int i, unsigned int j,int dF){
-    double moyenneRelief=0.;
-    std::vector<unsigned int> v = getIndPointsInLowerResolution(i,j,dF);
-    if(!v.empty()){
-        unsigned int IndP;
-        for(std::vector<unsigned int>::iterator it = std::begin(v); it != std::end(v); ++it) {
-            IndP=*it;
-            moyenneRelief+=reliefRepresentation.at(IndP);
-        }
-        moyenneRelief/=v.size();
-    }else{
-        moyenneRelief=-1;
+/**
+call f(Reducer()) with the reducer policy of reduction
+**/
+template<typename F>
+static void
+withReliefReducer(ReliefReduction reduction, const F &f){
+    switch(reduction){
+        case MEAN_RELIEF: f(MeanReducer()); break;
+        case SUM_RELIEF: f(SumReducer()); break;
+        case MEDIAN_RELIEF: f(MedianReducer()); break;
+        case COUNT_RELIEF: f(CountReducer()); break;
+        case P10_RELIEF: f(PercentileReducer<10>()); break;
+        case P90_RELIEF: f(PercentileReducer<90>()); break;
+        default: f(MaxReducer());
     }
-    return moyenneRelief;
 }
 
-
-
-double
-UnrolledMap::maxReliefRepresentation(unsigned int i, unsigned int j,int dF){
-    double maxReliefResolution=INT_MIN;
-    double currentRelief;
-    std::vector<unsigned int> v = getIndPointsInLowerResolution(i,j,dF);
-    if(!v.empty()){
-        unsigned int IndP;
-        for(std::vector<unsigned int>::iterator it = std::begin(v); it != std::end(v); ++it) {
-            IndP=*it;
-            currentRelief=reliefRepresentation.at(IndP);
-            if(currentRelief>maxReliefResolution){
-                maxReliefResolution=currentRelief;
-            }
-        }
-    }else{
-        maxReliefResolution=-1;
-    }
-    return maxReliefResolution;
+void
+UnrolledMap::setPixelPitch(double aHeightPitch, double anArcPitch){
+    assert(aHeightPitch>0 && anArcPitch>0);
+    heightPitch = aHeightPitch;
+    arcPitch = anArcPitch;
 }
 
-double
-UnrolledMap::medianReliefRepresentation(unsigned int i, unsigned int j,int dF) {
-    double medianRelief;
-    std::vector<unsigned int> v = getIndPointsInLowerResolution(i,j,dF);
-    unsigned int size = v.size();
-    if(size!=0){
-        std::sort(v.begin(), v.end());
-
-        if (size % 2 == 0){
-            double m1=reliefRepresentation.at(v.at(size / 2 - 1));
-            double m2=reliefRepresentation.at(v.at(size / 2));
-            medianRelief=(m1+m2)/2;
-        }else{
-            medianRelief=reliefRepresentation.at(v.at(size / 2));
-        }
-    }else{
-        medianRelief=-1;
-    }
-    return medianRelief;
+void
+UnrolledMap::setReliefReduction(ReliefReduction reduction){
+    reliefReduction = reduction;
 }
 
 Image2dGrayScale
 UnrolledMap::toGrayscaleImageMinMax(){
-    int grayscaleValue;
-    double reliefValue;
+    auto start = std::chrono::steady_clock::now();
     /*DGtal*/
     Image2dGrayScale grayScaleReliefImage=Image2dGrayScale(reliefImage.domain());
-    //SEARCH MIN MAX IN RELIEFIMAGE
-    double minDG, maxDG;
-    minDG=*min_element(reliefImage.range().begin(), reliefImage.range().end());
-    maxDG=*max_element(reliefImage.range().begin(), reliefImage.range().end());
+    int width=getWidth(reliefImage.domain());
+    //SEARCH MIN MAX IN RELIEFIMAGE, min and max of each band then of the bands
+    size_t nbBands=ThreadPool::getNbChunks(0, reliefImage.size()/width, ROW_GRAIN);
+    std::vector<float> bandMins(nbBands, std::numeric_limits<float>::max());
+    std::vector<float> bandMaxs(nbBands, std::numeric_limits<float>::lowest());
+    forEachRowBand(reliefImage.domain(), [&](size_t band, size_t r){
+        const float *row=&reliefImage[r*width];
+        for(int x = 0; x < width; x++){
+            bandMins[band]=std::min(bandMins[band],row[x]);
+            bandMaxs[band]=std::max(bandMaxs[band],row[x]);
+        }
+    });
+    double minDG=*min_element(bandMins.begin(), bandMins.end());
+    double maxDG=*max_element(bandMaxs.begin(), bandMaxs.end());
     trace.info()<<"min relief image dgtal :"<<minDG<<std::endl;
     trace.info()<<"max relief image dgtal:"<<maxDG<<std::endl;
-    GrayscaleColorMap<float> grayShade(minDG,maxDG);
-
-    for ( auto point : reliefImage.domain() ){
-      reliefValue=reliefImage(point);
-      grayscaleValue=((reliefValue-minDG)/(maxDG-minDG))*255;
-      grayScaleReliefImage.setValue(point,grayscaleValue);
-    }
 
+    forEachRowBand(reliefImage.domain(), [&](size_t, size_t r){
+        const float *row=&reliefImage[r*width];
+        unsigned char *grayRow=&grayScaleReliefImage[r*width];
+        for(int x = 0; x < width; x++){
+            int grayscaleValue=((row[x]-minDG)/(maxDG-minDG))*255;
+            grayRow[x]=grayscaleValue;
+        }
+    });
+    trace.info()<<"grayscale image [min ; max] : "<<getElapsedMs(start)<<" ms"<<std::endl;
     return grayScaleReliefImage;
 }
 
 Image2dGrayScale
 UnrolledMap::toGrayscaleImageFixed(int intensityPerCm, double reliefValueforZero){
+    auto start = std::chrono::steady_clock::now();
     float pad=1./intensityPerCm;
     double minDG=reliefValueforZero;
     double maxDG=(255*pad)+reliefValueforZero;
-    int grayscaleValue;
-    double reliefValue;
     //CREATE GRAYSCALE IMAGE
     Image2dGrayScale grayScaleReliefImage=Image2dGrayScale(reliefImage.domain());
     std::cout<<"GRAY : "<<reliefImage.domain()<<std::endl;
+    int width=getWidth(reliefImage.domain());
     //FILL THE GRAYSCALLE IMAGE
-    for ( auto point : reliefImage.domain() ){
-        reliefValue=reliefImage(point);
-        //trace.info()<<point<<std::endl;
-        grayscaleValue=((reliefValue-minDG)/(maxDG-minDG))*255;
-        if(grayscaleValue<0){
-            grayscaleValue=0;
-        }
-        if(grayscaleValue>255){
-            grayscaleValue=255;
+    forEachRowBand(reliefImage.domain(), [&](size_t, size_t r){
+        const float *row=&reliefImage[r*width];
+        unsigned char *grayRow=&grayScaleReliefImage[r*width];
+        for(int x = 0; x < width; x++){
+            int grayscaleValue=((row[x]-minDG)/(maxDG-minDG))*255;
+            if(grayscaleValue<0){
+                grayscaleValue=0;
+            }
+            if(grayscaleValue>255){
+                grayscaleValue=255;
+            }
+            grayRow[x]=grayscaleValue;
         }
-        grayScaleReliefImage.setValue(point,grayscaleValue);
-    }
+    });
+    trace.info()<<"grayscale image fixed : "<<getElapsedMs(start)<<" ms"<<std::endl;
     return grayScaleReliefImage;
 }
 
@@ -305,6 +322,7 @@ UnrolledMap::toGrayscaleImageFixed(int intensityPerCm, double reliefValueforZero
 void
 UnrolledMap::computeNormalizedImage(int dF) {
     trace.info()<<"Compute normalized image with decrease factor : 1 / "<<pow(2,dF)<<" ..."<<std::endl;
+    auto start = std::chrono::steady_clock::now();
     //resolution of relief imagev
     int pad=pow(2,dF);
     unsigned int resX=(angle_div-1)/pad;
@@ -313,125 +331,163 @@ UnrolledMap::computeNormalizedImage(int dF) {
     //resize reliefImageDGtal
     Z2i::Domain domain(Z2i::Point(0,0), Z2i::Point(resX,resY));
     reliefImage = Image2dNormalized(domain);
-    //init normalized map with the new resolution
-    double relief=0.;
-    int XNormMap,YNormMap;
-    //loop on the top left corner of all new cells
-    for(unsigned int i = 0; i < height_div-1; i+=pad){
-        for(unsigned int j = 0; j < angle_div-1; j+=pad){
-            //check if the cells is in the mesh -> to avoid some noise in the image
-            if(detectCellsIn(i,j)){
-                YNormMap =i/pad;
-                XNormMap=j/pad;
-                //get radius in dF resolution
-                relief=maxReliefRepresentation(i,j,pad);
-                //Radius = -1 when cells is empty
-                if(relief!=-1){
-                  //reliefImage.at<float>(YNormMap, XNormMap) = relief;
-                  reliefImage.setValue(Z2i::Point(XNormMap,YNormMap),relief);
+    int width=getWidth(domain);
+    withReliefReducer(reliefReduction, [&](auto reducer){
+        typedef decltype(reducer) Reducer;
+        //loop on the top left corner of all new cells, row YNormMap of the image is row i=YNormMap*pad of the surface
+        forEachRowBand(domain, [&](size_t, size_t YNormMap){
+            unsigned int i=YNormMap*pad;
+            if(i>=height_div-1){
+                return;
+            }
+            float *row=&reliefImage[YNormMap*width];
+            std::vector<double> values;
+            for(unsigned int j = 0; j < angle_div-1; j+=pad){
+                //check if the cells is in the mesh -> to avoid some noise in the image
+                if(detectCellsIn(i,j)){
+                    //get radius in dF resolution
+                    double relief;
+                    reduceReliefRepresentation<Reducer>(i,j,pad,values,&relief);
+                    //Radius = -1 when cells is empty
+                    if(relief!=-1){
+                      row[j/pad]=relief;
+                    }
                 }
             }
-
-        }
-    }
+        });
+    });
+    trace.info()<<"normalized image : "<<getElapsedMs(start)<<" ms"<<std::endl;
     //can't crop top and bot here
 }
 
 
+template<typename Reducer>
 void
-UnrolledMap::computeNormalizedImageMultiScale(){
-    trace.info()<<"Compute normalized image in multi scale ..."<<std::endl;
-    auto start = std::chrono::high_resolution_clock::now();
-    //resize reliefImageDGtal
-    Z2i::Domain domain(Z2i::Point(0,0), Z2i::Point(angle_div,height_div));
-    reliefImage = Image2dNormalized(domain);
-    int dF;
-    int maxDecreaseHit=0;
-    double relief;
-    double normalizedRelief;
-    //counter
-    int counterdf0=0;
-    int counterdf1=0;
-    int counterdf2=0;
-    int counterdf3=0;
-    int counterdf4=0;
-    int counter_out=0;
-    int counter_un=0;
+UnrolledMap::fillMultiScale(){
+    Z2i::Domain domain=reliefImage.domain();
+    int width=getWidth(domain);
+    //per band : max decrease resolution reached and number of cells out of the mesh
+    size_t nbBands=ThreadPool::getNbChunks(0, height_div+1, ROW_GRAIN);
+    std::vector<int> bandDecreaseHit(nbBands, 0);
+    std::vector<int> bandOut(nbBands, 0);
     //loop on all cells of unrolled surface
-    for(unsigned int i = 0; i < height_div; i++){
+    forEachRowBand(domain, [&](size_t band, size_t i){
+        if(i>=height_div){
+            return;
+        }
+        float *row=&reliefImage[i*width];
+        std::vector<double> values;
         for(unsigned int j = 0; j < angle_div; j++){
             if(detectCellsIn(i,j)){
-                relief=maxReliefRepresentation(i,j,0);
-                dF=1;
-
-
-                //while this vector is empty then find a little resolution where the corresponding i,j cells is not empty
+                double relief;
+                reduceReliefRepresentation<Reducer>(i,j,0,values,&relief);
+                int dF=1;
+                //while this cell is empty then find a little resolution where the corresponding i,j cells is not empty
                 while(relief==-1 && dF<maxDecreaseFactor){
-                    relief=maxReliefRepresentation(i,j,dF);
-                    //std::cout<<dF<<std::endl;
-
+                    reduceReliefRepresentation<Reducer>(i,j,dF,values,&relief);
                     //keep the max decrease resolution
-                    if(dF>=maxDecreaseHit){
-                        maxDecreaseHit=dF;
-                    }
+                    bandDecreaseHit[band]=std::max(bandDecreaseHit[band],dF);
                     //decrease resolution (1/decreaseHit)
                     dF+=1;
                 }
-                reliefImage.setValue(Z2i::Point(j,i),relief);
+                row[j]=relief;
             }else{
-              counter_out+=1;
+              bandOut[band]+=1;
             }
         }
-    }
-    /*auto stop = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
+    });
+    int maxDecreaseHit=*std::max_element(bandDecreaseHit.begin(), bandDecreaseHit.end());
+    int counter_out=std::accumulate(bandOut.begin(), bandOut.end(), 0);
     int nbPixels=(angle_div)*(height_div);
     trace.info()<<"decrease paramater down to : "<<maxDecreaseHit<<std::endl;
-    trace.info()<<"RATIO (for : "<<nbPixels<<" nb picels)"<<std::endl;
-    trace.info()<<"at df=0 completion : "<<double(counterdf0)/nbPixels<< "nb pixel search in df=0 "<<counterdf0<<std::endl;
-    trace.info()<<"at df=1 completion : "<<double(counterdf1)/nbPixels<< "nb pixel search in df=1 "<<counterdf1<<std::endl;
-    trace.info()<<"at df=2 completion : "<<double(counterdf2)/nbPixels<< "nb pixel search in df=2 "<<counterdf2<<std::endl;
-    trace.info()<<"at df=3 completion : "<<double(counterdf3)/nbPixels<< "nb pixel search in df=3 "<<counterdf3<<std::endl;
-    trace.info()<<"at df=4 completion : "<<double(counterdf4)/nbPixels<< "nb pixel search in df=4 "<<counterdf4<<std::endl;
-
     trace.info()<<counter_out<< " pixels not traited so : "<<double(counter_out)/nbPixels<<" ratio  "<<std::endl;
-    trace.info()<<"at beginin they are  : "<<nbPixels-counter_un<<" pixels set"<<std::endl;
-    trace.info()<<"end multi scale research ... Duration : "<<duration.count()<<" microseconds"<<std::endl;*/
+}
+
+void
+UnrolledMap::computeNormalizedImageMultiScale(){
+    trace.info()<<"Compute normalized image in multi scale ..."<<std::endl;
+    auto start = std::chrono::steady_clock::now();
+    //resize reliefImageDGtal
+    Z2i::Domain domain(Z2i::Point(0,0), Z2i::Point(angle_div,height_div));
+    reliefImage = Image2dNormalized(domain);
+    //max, sum and count of the cells at all the resolutions
+    reliefPyramid.build(unrolled_surface, height_div, angle_div, reliefRepresentation, maxDecreaseFactor);
+    withReliefReducer(reliefReduction, [&](auto reducer){
+        fillMultiScale<decltype(reducer)>();
+    });
+    trace.info()<<"end multi scale research ... Duration : "<<getElapsedMs(start)<<" ms"<<std::endl;
     cropTopBotImage();
 }
 
+void
+UnrolledMap::computeReliefTensor(std::vector<float> &tensor, int &nbRows, int &nbCols){
+    trace.info()<<"Compute relief tensor ..."<<std::endl;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<double> radii(CPoints.size());
+    for(unsigned int i = 0; i < CPoints.size(); i++){
+        radii[i]=CPoints[i].radius;
+    }
+    radiusPyramid.build(unrolled_surface, height_div, angle_div, radii, maxDecreaseFactor);
+    //rows of the cropped image
+    nbRows=minIndBot-maxIndTop;
+    nbCols=angle_div;
+    size_t channelSize=(size_t) nbRows*nbCols;
+    tensor.assign(RELIEF_TENSOR_CHANNELS*channelSize, 0.f);
+    float *reliefMax=tensor.data();
+    float *reliefMean=reliefMax+channelSize;
+    float *count=reliefMean+channelSize;
+    float *radius=count+channelSize;
+    float *fillLevel=radius+channelSize;
+    Z2i::Domain domain(Z2i::Point(0,0), Z2i::Point(nbCols-1,nbRows-1));
+    forEachRowBand(domain, [&](size_t, size_t r){
+        unsigned int i=r+maxIndTop;
+        for(int j = 0; j < nbCols; j++){
+            size_t p=r*nbCols+j;
+            fillLevel[p]=-1;
+            if(!detectCellsIn(i,j)){
+                continue;
+            }
+            //points of the cell itself, not of the block the values come from
+            count[p]=reliefPyramid.getCount(0,i,j);
+            //first resolution where the block of (i,j) is not empty
+            for(int dF = 0; dF < reliefPyramid.getNbLevels(); dF++){
+                if(reliefPyramid.getCount(dF,i,j)==0){
+                    continue;
+                }
+                reliefMax[p]=reliefPyramid.getMax(dF,i,j);
+                reliefMean[p]=reliefPyramid.getMean(dF,i,j);
+                radius[p]=radiusPyramid.getMean(dF,i,j);
+                fillLevel[p]=dF;
+                break;
+            }
+        }
+    });
+    trace.info()<<"relief tensor ["<<RELIEF_TENSOR_CHANNELS<<" ; "<<nbRows<<" ; "<<nbCols<<" ] : "<<getElapsedMs(start)<<" ms"<<std::endl;
+}
+
 void
 UnrolledMap::cropTopBotImage(){
     trace.info()<<"start crop top and bot ..."<<std::endl;
     int colsDG=reliefImage.domain().upperBound()[0];
     int rowsDG=reliefImage.domain().upperBound()[1];
 
-    double currentPixelValue;
-    unsigned int x,y;
+    auto start = std::chrono::steady_clock::now();
+    //first and last non zero pixel of each column
+    int width=getWidth(reliefImage.domain());
+    std::vector<int> firstRows, lastRows;
+    computeColumnBounds(height_div, colsDG, [&](int y, int x){
+        return reliefImage[(size_t) y*width+x]!=0;
+    }, firstRows, lastRows);
     //Search the max ind point (different zeros) from top normalized image
     unsigned int maxIT_DGtal=0;
-    for(x = 0; x < colsDG; x++){
-        currentPixelValue=reliefImage(Z2i::Point(x,0));
-        y=0;
-        while (currentPixelValue==0) {
-            y=y+1;
-            currentPixelValue=reliefImage(Z2i::Point(x,y));
-        }
-        if(y>maxIT_DGtal){
-            maxIT_DGtal=y;
-        }
-    }
     unsigned int minIB_DGtal=height_div-1;
-    for(x = 0; x < colsDG; x++){
-      currentPixelValue=reliefImage(Z2i::Point(x,height_div-1));
-      y=height_div-1;
-      while (currentPixelValue==0) {
-          y=y-1;
-          currentPixelValue=reliefImage(Z2i::Point(x,y));
-      }
-      if(y<minIB_DGtal){
-          minIB_DGtal=y;
-      }
+    for(int x = 0; x < colsDG; x++){
+        //columns without any pixel do not bound the crop
+        if(lastRows[x]<0){
+            continue;
+        }
+        maxIT_DGtal=std::max<unsigned int>(maxIT_DGtal,firstRows[x]);
+        minIB_DGtal=std::min<unsigned int>(minIB_DGtal,lastRows[x]);
     }
     typedef ConstImageAdapter<Image2dNormalized, Z2i::Domain, functors::Identity, Image2dNormalized::Value, functors::Identity > ConstImageAdapterForSubImage;
     functors::Identity df;
@@ -445,32 +501,34 @@ UnrolledMap::cropTopBotImage(){
     //update attribut maxIndTop and minIndBot
     maxIndTop=maxIT_DGtal;
     minIndBot=minIB_DGtal;
-    trace.info()<< "max IndTop :  "<<maxIndTop<< "min indBot : "<<minIndBot<< std::endl;
+    trace.info()<< "max IndTop :  "<<maxIndTop<< "min indBot : "<<minIndBot<< " ("<<maxIndTop*heightPitch<<" mm , "<<minIndBot*heightPitch<<" mm)"<< std::endl;
     reliefImage=croppedImage;
+    trace.info()<<"crop top and bot : "<<getElapsedMs(start)<<" ms"<<std::endl;
 
 }
 
 void
 UnrolledMap::computeRGBImage(){
-    double reliefValue;
-    Color reliefColor;
     //first : compute in grayScale
     Image2dGrayScale reliefGray = toGrayscaleImageFixed(intensity_per_cm,zero_level_intensity);
+    auto start = std::chrono::steady_clock::now();
     //second : convert grayscale to rgb
     imageRGB imagergb=imageRGB(reliefGray.domain());
 
     float min=*min_element(reliefGray.range().begin(), reliefGray.range().end());
     float max=*max_element(reliefGray.range().begin(), reliefGray.range().end());
     GradientColorMap<float,CMAP_COPPER> gradient( min, max);
-    for ( auto point : reliefGray.domain() ){
-        reliefValue=reliefGray(point);
-        //trace.info()<<point<<std::endl;
-        reliefColor=gradient(reliefValue);
-
-        imagergb.setValue(point,reliefColor);
-    }
+    int width=getWidth(reliefGray.domain());
+    forEachRowBand(reliefGray.domain(), [&](size_t, size_t r){
+        const unsigned char *grayRow=&reliefGray[r*width];
+        Color *rgbRow=&imagergb[r*width];
+        for(int x = 0; x < width; x++){
+            rgbRow[x]=gradient(grayRow[x]);
+        }
+    });
 
     reliefImageRGB=imagergb;
+    trace.info()<<"rgb image : "<<getElapsedMs(start)<<" ms"<<std::endl;
 }
 void
 UnrolledMap::computeGRAYImage(){
@@ -505,11 +563,27 @@ CylindricalPoint
 UnrolledMap::getCPoint(unsigned int i){
     return CPoints.at(i);
 }
-std::vector<std::vector<std::vector<unsigned int>>>
+const CsrIndex &
 UnrolledMap::getDiscretisation(){
   return unrolled_surface;
 }
 int
+UnrolledMap::getHeightDiv(){
+  return height_div;
+}
+int
+UnrolledMap::getAngleDiv(){
+  return angle_div;
+}
+double
+UnrolledMap::getHeightPitch(){
+  return heightPitch;
+}
+double
+UnrolledMap::getArcPitch(){
+  return arcPitch;
+}
+int
 UnrolledMap::getRowCroppedBot(){
   return maxIndTop;
 }
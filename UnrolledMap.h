@@ -4,13 +4,20 @@
 #include <utility>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
 #include "CylindricalPoint.h"
+#include "CsrIndex.h"
+#include "ReliefPyramid.h"
+#include "ReliefReducer.h"
+#include "Span.h"
 
 #include "DGtal/images/ImageContainerBySTLVector.h"
 #include "DGtal/io/boards/Board2D.h"
 
 using namespace DGtal;
+  //channels of the relief tensor : relief max, relief mean, count, radius, fill level
+  #define RELIEF_TENSOR_CHANNELS 5
   //Image of double to store normalized values
   typedef ImageContainerBySTLVector<Z2i::Domain, float> Image2dNormalized;
   //Image of Char to make a grayscale image
@@ -51,14 +58,25 @@ class UnrolledMap{
       reliefImageRGB(um.reliefImageRGB),
       maxIndTop(um.maxIndTop),
       minIndBot(um.minIndBot),
+      unrolled_surface(um.unrolled_surface),
+      firstRowIn(um.firstRowIn),
+      lastRowIn(um.lastRowIn),
+      reliefReduction(um.reliefReduction),
       height_div(um.height_div),
-      angle_div(um.angle_div){};
+      angle_div(um.angle_div),
+      heightPitch(um.heightPitch),
+      arcPitch(um.arcPitch){};
 
     /**
     return false if cells is consiedred out of the mesh (function to skip noise in relief image)
     **/
     bool detectCellsIn(unsigned int i, unsigned int j);
     /**
+    size (mm) of a cell along the height and along the arc at the mean radius, 1 by default.
+    Must be set before computeDicretisation.
+    **/
+    void setPixelPitch(double heightPitch, double arcPitch);
+    /**
     Compute discretisation
      **/
     void computeDicretisation();
@@ -71,6 +89,20 @@ class UnrolledMap{
      **/
     void computeNormalizedImageMultiScale();
     /**
+    Fill tensor (RELIEF_TENSOR_CHANNELS x nbRows x nbCols floats, channel after channel) over the cropped
+    relief image : max and mean of the relief, number of points, mean radius and level of the multi scale
+    search (0 : the cell itself, dF : block of 2^dF x 2^dF cells). Max, mean and radius come from the
+    first non empty level, the number of points is always the one of the cell itself (0 for a cell filled
+    from a coarser level). Pixels out of the mesh or still empty at the lowest resolution have 0 everywhere
+    and a fill level of -1.
+    Need computeNormalizedImageMultiScale.
+    **/
+    void computeReliefTensor(std::vector<float> &tensor, int &nbRows, int &nbCols);
+    /**
+    reduction of the relief of the points of a cell in the relief image (default MAX_RELIEF)
+    **/
+    void setReliefReduction(ReliefReduction reduction);
+    /**
     write rgb image from normalized image
     **/
     void computeRGBImage();
@@ -84,9 +116,9 @@ class UnrolledMap{
     **/
     std::vector<unsigned int > getIndPointsInLowerResolution(unsigned int i,unsigned int j,int dF);
     /**
-    return the vector of ind at pos (i,j) in unrolled_surface. Need unrolled_sruface to be build
+    return the ind at pos (i,j) (i counted from the cropped top) in unrolled_surface. Need unrolled_sruface to be build
     **/
-    std::vector<unsigned int > getPointsUnrolled_surface(unsigned int i,unsigned int j);
+    Span<const unsigned int> getPointsUnrolled_surface(unsigned int i,unsigned int j);
     /**
     return ground truth image. NOT ANUMORE DISPONIBLE. TODO : IMPLEMENT IN DGTal
     **/
@@ -115,9 +147,13 @@ class UnrolledMap{
     **/
     CylindricalPoint getCPoint(unsigned int);
     /**
-    return discretisation vectors
+    return discretisation, cell (i,j) is i*getAngleDiv()+j
     **/
-    std::vector<std::vector<std::vector<unsigned int>>> getDiscretisation();
+    const CsrIndex &getDiscretisation();
+    double getHeightPitch();
+    double getArcPitch();
+    int getHeightDiv();
+    int getAngleDiv();
     /**
     return the nb row cropped
     **/
@@ -138,36 +174,67 @@ class UnrolledMap{
     Image2dGrayScale toGrayscaleImageFixed(int intensityPerCm,double reliefValueforZero);
 
     /**
-    return the mean of relief representation. You can specify the resolution by dF : 1/dF.
-    if df=1 return the mean at position (i,j) in unrolled surface.
+    reductions (CellReducer<Reducers...>) of the relief of the region of size 2^dF x 2^dF containing (i,j),
+    -1 if the region is empty. if dF=0 reduce the cell (i,j) of unrolled surface.
+    values is a work buffer, filled only if a reducer needs the values of the points.
+    **/
+    template<typename... Reducers>
+    void reduceReliefRepresentation(unsigned int i, unsigned int j, int dF, std::vector<double> &values, double *out) const;
+    /**
+    fill reliefImage at full resolution with Reducer, empty cells are filled from lower resolutions
     **/
-    double meansReliefRepresentation(unsigned int i, unsigned int j,int dF);
+    template<typename Reducer>
+    void fillMultiScale();
     /**
-    return the max of relief representation. You can specify the resolution by dF : 1/dF.
-    if df=1 return the mean at position (i,j) in unrolled surface.
+    first[j] (last[j]) : first (last) row i of column j where isSet(i,j), nbRows (-1) if there is none.
+    Each column is scanned from both ends, columns run in parallel.
     **/
-    double maxReliefRepresentation(unsigned int i, unsigned int j,int dF);
-    //double maxReliefRepresentationv2(unsigned int i, unsigned int j,int dF);
+    template<typename F>
+    void computeColumnBounds(int nbRows, int nbCols, const F &isSet, std::vector<int> &first, std::vector<int> &last);
     /**
-    return the sum of relief representation. You can specify the resolution by dF : 1/dF.
-    if df=1 return the mean at position (i,j) in unrolled surface.
+    return the ind of cell (i,j) of unrolled_surface
     **/
-    double sumReliefRepresentation(unsigned int i, unsigned int j,int dF);
+    Span<const unsigned int> getCell(unsigned int i, unsigned int j) const {
+      return unrolled_surface.cell((size_t) i*angle_div+j);
+    }
     /**
-    return the median of relief representation. You can specify the resolution by dF : 1/dF.
-    if df=1 return the mean at position (i,j) in unrolled surface.
+    call f(indPoint) on the points of the region of size pad x pad containing (i,j)
     **/
-    double medianReliefRepresentation(unsigned int i, unsigned int j,int dF);
+    template<typename F>
+    void forEachInLowerResolution(unsigned int i,unsigned int j,int pad, const F &f) const {
+      unsigned int topLeftCornerHeight=(i/pad)*pad;
+      unsigned int topLeftCornerTheta=(j/pad)*pad;
+      unsigned int endHeight=std::min<unsigned int>(topLeftCornerHeight+pad,height_div);
+      unsigned int endTheta=std::min<unsigned int>(topLeftCornerTheta+pad,angle_div);
+      for(unsigned int k = topLeftCornerHeight; k < endHeight; k++){
+        for(unsigned int l = topLeftCornerTheta; l < endTheta; l++){
+          for(unsigned int indP : getCell(k,l)){
+            f(indP);
+          }
+        }
+      }
+    }
 
 
-    //unrolled surface representation : each cells contain some index points.
-    std::vector<std::vector<std::vector<unsigned int>>> unrolled_surface;
+    //unrolled surface representation : each cells contain some index points, height_div x angle_div cells in CSR.
+    CsrIndex unrolled_surface;
+    //first and last non empty rows of each column of unrolled_surface
+    std::vector<int> firstRowIn, lastRowIn;
+    //max, sum and count of the relief of the cells at each resolution
+    ReliefPyramid reliefPyramid;
+    //same for the radius of the points (relief tensor only)
+    ReliefPyramid radiusPyramid;
+    //reduction of the cells in the relief image
+    ReliefReduction reliefReduction = MAX_RELIEF;
     //Represenation of the relief, radius of deltadiff.
     std::vector<double> reliefRepresentation;
     //Cylindricales Points
     std::vector<CylindricalPoint> CPoints;
     //discretisation
     int height_div, angle_div;
+    //size of a cell (mm) along the height and along the arc
+    double heightPitch = 1.;
+    double arcPitch = 1.;
     //the maximum decrease factor for multi resolution research (2^n) with n = decreaseFactor
     int maxDecreaseFactor;
     //index of lines to be cropped
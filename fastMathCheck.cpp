@@ -0,0 +1,134 @@
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include "FastMath.h"
+
+//max absolute error accepted against std::atan2 (rad)
+#define FAST_MATH_TOLERANCE 1e-5
+#define BENCH_NB_VALUES 1000000
+#define BENCH_NB_REPEATS 20
+
+/**
+ * Accuracy test and microbenchmark of FastMath::atan2 against std::atan2.
+ * The scalar path is FastMath::atan2(y, x), the SSE2 path the batch
+ * FastMath::atan2(ys, xs, out, n) with an even n (every value goes
+ * through the vector loop). Returns 1 if one of the paths exceeds the tolerance.
+ **/
+
+//(y, x) on a polar sweep at several radii, plus the axes, signed zeros and tiny/huge values
+static void
+buildSweep(std::vector<double> &ys, std::vector<double> &xs)
+{
+  const double specials[] = {0.0, -0.0, 1.0, -1.0, 1e-300, -1e-300,
+                             std::numeric_limits<double>::denorm_min(),
+                             -std::numeric_limits<double>::denorm_min(),
+                             std::numeric_limits<double>::min(), 1e300, -1e300};
+  for(double y : specials){
+    for(double x : specials){
+      ys.push_back(y);
+      xs.push_back(x);
+    }
+  }
+  const double radii[] = {1e-310, 1e-20, 1.0, 1e5, 1e20};
+  const unsigned int nbAngles = 100000;
+  for(double r : radii){
+    for(unsigned int k = 0; k < nbAngles; k++){
+      double theta = -M_PI + 2 * M_PI * k / nbAngles;
+      ys.push_back(r * std::sin(theta));
+      xs.push_back(r * std::cos(theta));
+    }
+  }
+  if(ys.size() % 2 != 0){
+    ys.push_back(1.0);
+    xs.push_back(1.0);
+  }
+}
+
+static double
+maxError(const std::vector<double> &ys, const std::vector<double> &xs,
+         const std::vector<double> &out, size_t &worst)
+{
+  double maxErr = 0.0;
+  worst = 0;
+  for(size_t i = 0; i < ys.size(); i++){
+    double err = std::abs(out[i] - std::atan2(ys[i], xs[i]));
+    if(!(err <= maxErr)){
+      maxErr = err;
+      worst = i;
+    }
+  }
+  return maxErr;
+}
+
+//ns per value of f, best of BENCH_NB_REPEATS runs
+template<typename F>
+static double
+timeIt(F f)
+{
+  double best = std::numeric_limits<double>::max();
+  for(unsigned int k = 0; k < BENCH_NB_REPEATS; k++){
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+  }
+  return best / BENCH_NB_VALUES;
+}
+
+int
+main()
+{
+  std::vector<double> ys, xs;
+  buildSweep(ys, xs);
+  std::vector<double> scalarOut(ys.size());
+  std::vector<double> batchOut(ys.size());
+  for(size_t i = 0; i < ys.size(); i++){
+    scalarOut[i] = FastMath::atan2(ys[i], xs[i]);
+  }
+  FastMath::atan2(ys.data(), xs.data(), batchOut.data(), ys.size());
+
+  bool ok = true;
+  size_t worst;
+  double scalarErr = maxError(ys, xs, scalarOut, worst);
+  std::cout << "scalar : max error " << scalarErr << " at (y, x) = (" << ys[worst] << ", " << xs[worst] << ")" << std::endl;
+  ok = ok && scalarErr < FAST_MATH_TOLERANCE;
+  double batchErr = maxError(ys, xs, batchOut, worst);
+#ifdef __SSE2__
+  std::cout << "sse2   : max error " << batchErr << " at (y, x) = (" << ys[worst] << ", " << xs[worst] << ")" << std::endl;
+#else
+  std::cout << "batch (no SSE2) : max error " << batchErr << " at (y, x) = (" << ys[worst] << ", " << xs[worst] << ")" << std::endl;
+#endif
+  ok = ok && batchErr < FAST_MATH_TOLERANCE;
+
+  //benchmark on random-looking angles in the whole plane
+  std::vector<double> by(BENCH_NB_VALUES), bx(BENCH_NB_VALUES), bout(BENCH_NB_VALUES);
+  for(unsigned int i = 0; i < BENCH_NB_VALUES; i++){
+    double theta = std::fmod(i * 2.399963229728653, 2 * M_PI) - M_PI;
+    by[i] = std::sin(theta) * (1 + i % 7);
+    bx[i] = std::cos(theta) * (1 + i % 7);
+  }
+  double tStd = timeIt([&](){
+    for(unsigned int i = 0; i < BENCH_NB_VALUES; i++){
+      bout[i] = std::atan2(by[i], bx[i]);
+    }
+  });
+  double tScalar = timeIt([&](){
+    for(unsigned int i = 0; i < BENCH_NB_VALUES; i++){
+      bout[i] = FastMath::atan2(by[i], bx[i]);
+    }
+  });
+  double tBatch = timeIt([&](){
+    FastMath::atan2(by.data(), bx.data(), bout.data(), BENCH_NB_VALUES);
+  });
+  std::cout << "std::atan2 " << tStd << " ns, scalar " << tScalar << " ns (x" << tStd / tScalar
+            << "), batch " << tBatch << " ns (x" << tStd / tBatch << ") per value" << std::endl;
+
+  if(!ok){
+    std::cerr << "error: FastMath::atan2 exceeds the tolerance " << FAST_MATH_TOLERANCE << std::endl;
+    return 1;
+  }
+  return 0;
+}
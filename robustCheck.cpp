@@ -0,0 +1,107 @@
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_multifit.h>
+#include "Regression.h"
+
+//max difference accepted on each coefficient c : |c - cGsl| <= tolerance * (1 + |cGsl|)
+#define ROBUST_CHECK_TOLERANCE 1e-6
+#define ROBUST_CHECK_NB_PATCHES 200
+
+/**
+ * Check of Regression::robustLinear against gsl_multifit_robust with gsl_multifit_robust_fair,
+ * on patches shaped like the ones of the segmentation (height in mm, radius around 150 mm) :
+ * noisy lines with bumps (defects), exact lines and nearly exact lines.
+ * robustLinear stops with the least squares line when the MAD sigma is 0 (more than half of the
+ * points exactly on the line) where GSL scales the residuals by 1 / sigma, the exact lines cover it.
+ * Returns 1 if one of the coefficients exceeds the tolerance.
+ **/
+
+//(slope, intercept) of gsl_multifit_robust with the fair weight function
+static std::pair<double, double>
+gslFair(const std::vector<double> &xs, const std::vector<double> &ys)
+{
+  size_t n = xs.size();
+  gsl_matrix *X = gsl_matrix_alloc(n, 2);
+  gsl_vector *y = gsl_vector_alloc(n);
+  gsl_vector *c = gsl_vector_alloc(2);
+  gsl_matrix *cov = gsl_matrix_alloc(2, 2);
+  for(size_t i = 0; i < n; i++){
+    gsl_matrix_set(X, i, 0, 1.0);
+    gsl_matrix_set(X, i, 1, xs[i]);
+    gsl_vector_set(y, i, ys[i]);
+  }
+  gsl_multifit_robust_workspace *work = gsl_multifit_robust_alloc(gsl_multifit_robust_fair, n, 2);
+  gsl_multifit_robust(X, y, c, cov, work);
+  std::pair<double, double> coeffs(gsl_vector_get(c, 1), gsl_vector_get(c, 0));
+  gsl_multifit_robust_free(work);
+  gsl_matrix_free(cov);
+  gsl_vector_free(c);
+  gsl_vector_free(y);
+  gsl_matrix_free(X);
+  return coeffs;
+}
+
+//line of slope a and intercept b on n heights, gaussian noise, a fraction of the points lifted by a bump
+static void
+makePatch(std::mt19937 &generator, size_t n, double a, double b, double noise, double bumpRatio,
+          std::vector<double> &xs, std::vector<double> &ys)
+{
+  std::uniform_real_distribution<double> height(0., 100.);
+  std::normal_distribution<double> gauss(0., 1.);
+  std::uniform_real_distribution<double> uniform(0., 1.);
+  xs.resize(n);
+  ys.resize(n);
+  for(size_t i = 0; i < n; i++){
+    xs[i] = height(generator);
+    ys[i] = a * xs[i] + b + noise * gauss(generator);
+    if(uniform(generator) < bumpRatio){
+      ys[i] += 2. + 3. * uniform(generator);
+    }
+  }
+}
+
+static bool
+isClose(double c, double cGsl)
+{
+  return std::abs(c - cGsl) <= ROBUST_CHECK_TOLERANCE * (1. + std::abs(cGsl));
+}
+
+int
+main()
+{
+  gsl_set_error_handler_off();
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int> size(MIN_NB_POINTS, 2000);
+  std::uniform_real_distribution<double> slope(-0.1, 0.1);
+  std::uniform_real_distribution<double> radius(100., 200.);
+  const char *names[] = {"bumped", "exact", "nearly exact"};
+  const double noises[] = {0.3, 0., 1e-6};
+  const double bumpRatios[] = {0.2, 0., 0.};
+  bool ok = true;
+  std::vector<double> xs, ys;
+  for(int kind = 0; kind < 3; kind++){
+    double maxDiffSlope = 0., maxDiffIntercept = 0.;
+    for(int k = 0; k < ROBUST_CHECK_NB_PATCHES; k++){
+      makePatch(generator, size(generator), slope(generator), radius(generator), noises[kind], bumpRatios[kind], xs, ys);
+      std::pair<double, double> mine = Regression::robustLinear(xs, ys);
+      std::pair<double, double> reference = gslFair(xs, ys);
+      maxDiffSlope = std::max(maxDiffSlope, std::abs(mine.first - reference.first));
+      maxDiffIntercept = std::max(maxDiffIntercept, std::abs(mine.second - reference.second));
+      if(!isClose(mine.first, reference.first) || !isClose(mine.second, reference.second)){
+        std::cerr << names[kind] << " patch of " << xs.size() << " points : (" << mine.first << ", " << mine.second
+                  << ") gsl (" << reference.first << ", " << reference.second << ")" << std::endl;
+        ok = false;
+      }
+    }
+    std::cout << names[kind] << " : max difference slope " << maxDiffSlope << " intercept " << maxDiffIntercept << std::endl;
+  }
+  if(!ok){
+    std::cerr << "error: robustLinear differs from gsl_multifit_robust (fair) above " << ROBUST_CHECK_TOLERANCE << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -42,13 +42,18 @@ main(int argc,char **argv)
   //vector of id defects
   std::vector<unsigned int> idOfDefect;
   //the discretisation map
-  std::vector<std::vector<std::vector<unsigned int>>> discretisation;
+  CsrIndex discretisation;
+  int discretisationRows=0;
+  int discretisationCols=0;
+  double heightPitch=1.;
+  double arcPitch=1.;
   //number of row to jump
   int rowCroppedBot=0;
   int rowCroppedTop=0;
   //read from discretisation.txt
 
-  IOHelper::readDiscretisationFromFile("discretisation.txt",discretisation,rowCroppedBot,rowCroppedTop);
+  IOHelper::readDiscretisationFromFile("discretisation.txt",discretisation,discretisationRows,discretisationCols,heightPitch,arcPitch,rowCroppedBot,rowCroppedTop);
+  trace.info()<<"discretisation : [ "<<discretisationRows<<" ; "<<discretisationCols<<" ] pixel pitch : [ "<<heightPitch<<" ; "<<arcPitch<<" ] mm"<<std::endl;
 
   //the segmentation image
   typedef ImageContainerBySTLVector < Z2i::Domain, unsigned char> Image;
@@ -57,20 +62,21 @@ main(int argc,char **argv)
   //cols = width || rows = height
   int cols=image2D.domain().upperBound()[0];
   int rows=image2D.domain().upperBound()[1];
+  //the segmentation map must lie inside the discretisation (cell (j+rowCroppedBot, i))
+  if(rowCroppedBot < 0 || cols > discretisationCols || rows + rowCroppedBot > discretisationRows){
+    trace.error()<<"segmentation map [ "<<rows<<" ; "<<cols<<" ] (first row "<<rowCroppedBot
+                 <<") does not fit in the discretisation [ "<<discretisationRows<<" ; "<<discretisationCols<<" ]"<<std::endl;
+    return 1;
+  }
 
   //loop on segmentation map and fill a vector of defects indices
   int currentIntensity;
-  std::vector<unsigned int>  currentPointsInPixels;
-  unsigned int IndP;
   for (int i=0; i < cols; ++i){
     for (int j=0; j < rows; ++j){
       currentIntensity=image2D(Z2i::Point(i,j));
       if(currentIntensity>0){
-        currentPointsInPixels=discretisation.at(j+rowCroppedBot).at(i);
-        for(std::vector<unsigned int>::iterator it = std::begin(currentPointsInPixels); it != std::end(currentPointsInPixels); ++it) {
-          IndP=*it;
-          idOfDefect.push_back(IndP);
-        }
+        Span<const unsigned int> currentPointsInPixels=discretisation.cell((size_t) (j+rowCroppedBot)*discretisationCols+i);
+        idOfDefect.insert(idOfDefect.end(), currentPointsInPixels.begin(), currentPointsInPixels.end());
       }
     }
   }